@@ -9,10 +9,9 @@
 
 int main()
 {
-    srand(time(NULL)); // Initialise RNG
-
     RTCDevice device = rtcNewDevice(NULL);
     RenderManager renderer(&device, Camera(glm::vec3(0.0f, 0.0f, 3.0f), 45.0f, 0.01f, 1000.0f), false, 50, 4);
+    renderer.SetRandomSeed(time(NULL)); // Initialise RNG
 
     MaterialProperties mainWallsMat = MaterialProperties();
     MaterialProperties leftWallMat = MaterialProperties();
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <sys/types.h>
+#include <glm/glm.hpp>
+
+#define MORTON_AXIS_BITS 21
+
+// Moves Bit i of the Low 21 Bits to Bit 3i
+inline u_int64_t MortonSpreadBits(u_int32_t coordinate)
+{
+    u_int64_t value = coordinate & 0x1FFFFF;
+    value = (value | (value << 32)) & 0x1F00000000FFFFull;
+    value = (value | (value << 16)) & 0x1F0000FF0000FFull;
+    value = (value | (value << 8)) & 0x100F00F00F00F00Full;
+    value = (value | (value << 4)) & 0x10C30C30C30C30C3ull;
+    value = (value | (value << 2)) & 0x1249249249249249ull;
+    return value;
+}
+
+inline u_int64_t MortonCode(u_int32_t x, u_int32_t y, u_int32_t z)
+{
+    return MortonSpreadBits(x) | (MortonSpreadBits(y) << 1) | (MortonSpreadBits(z) << 2);
+}
+
+// Quantises the Point to 21 Bits per Axis within the Bounds, so Sorting by Code Walks the Bounds along a Z-Order Curve
+inline u_int64_t MortonCode(glm::vec3 point, glm::vec3 lowerBound, glm::vec3 upperBound)
+{
+    float cellCount = (float)((1u << MORTON_AXIS_BITS) - 1);
+    glm::vec3 scale = cellCount / glm::max(upperBound - lowerBound, glm::vec3(1e-20f));
+    glm::vec3 cell = glm::clamp((point - lowerBound) * scale, 0.0f, cellCount);
+    return MortonCode((u_int32_t)cell.x, (u_int32_t)cell.y, (u_int32_t)cell.z);
+}
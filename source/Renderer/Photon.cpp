@@ -0,0 +1,96 @@
+#include "Photon.hpp"
+
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+// Decoded Directions Read the Centre of each Theta and Phi Bin from Tables, so Gathers never Call Trigonometric Functions
+struct DirectionTables
+{
+    float cosTheta[256];
+    float sinTheta[256];
+    float cosPhi[256];
+    float sinPhi[256];
+
+    DirectionTables()
+    {
+        for (u_int32_t i = 0; i < 256; i++)
+        {
+            float theta = (i + 0.5f) * (glm::pi<float>() / 256.0f);
+            float phi = (i + 0.5f) * (glm::two_pi<float>() / 256.0f);
+            cosTheta[i] = std::cos(theta);
+            sinTheta[i] = std::sin(theta);
+            cosPhi[i] = std::cos(phi);
+            sinPhi[i] = std::sin(phi);
+        }
+    }
+};
+
+static const DirectionTables directionTables;
+
+void Photon::SetPower(glm::vec3 colour)
+{
+    float maxComponent = glm::max(colour.r, glm::max(colour.g, colour.b));
+    if (maxComponent < 1e-32f)
+    {
+        power[0] = power[1] = power[2] = power[3] = 0;
+        return;
+    }
+
+    // The Largest Component's Mantissa Lands in [128, 256), and the Others Share its Exponent
+    int exponent;
+    float scale = std::frexp(maxComponent, &exponent) * 256.0f / maxComponent;
+    for (u_int32_t c = 0; c < 3; c++)
+        power[c] = (u_int8_t)glm::clamp(std::floor((glm::max(colour[c], 0.0f) * scale) + 0.5f), 0.0f, 255.0f);
+    power[3] = (u_int8_t)(exponent + 128);
+}
+
+glm::vec3 Photon::Power() const
+{
+    if (power[3] == 0)
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+
+    float scale = std::ldexp(1.0f, (int)power[3] - (128 + 8));
+    return glm::vec3(power[0] * scale, power[1] * scale, power[2] * scale);
+}
+
+void Photon::SetDirection(glm::vec3 direction)
+{
+    direction = glm::normalize(direction);
+
+    int thetaBin = (int)(std::acos(glm::clamp(direction.z, -1.0f, 1.0f)) * (256.0f / glm::pi<float>()));
+    // Floored, as Truncation would Round Negative Azimuths Up into the Bin above
+    int phiBin = (int)std::floor(std::atan2(direction.y, direction.x) * (256.0f / glm::two_pi<float>()));
+
+    theta = (u_int8_t)glm::min(thetaBin, 255);
+    phi = (u_int8_t)(phiBin < 0 ? phiBin + 256 : glm::min(phiBin, 255));
+}
+
+glm::vec3 Photon::Direction() const
+{
+    return glm::vec3(directionTables.sinTheta[theta] * directionTables.cosPhi[phi],
+                     directionTables.sinTheta[theta] * directionTables.sinPhi[phi],
+                     directionTables.cosTheta[theta]);
+}
+
+void Photon::SetNormal(glm::vec3 normal)
+{
+    // Projected onto the Octahedron |x| + |y| + |z| = 1, whose Lower Half is Folded out over the Corners of the Square
+    normal /= glm::max(glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z), 1e-20f);
+    glm::vec2 square(normal.x, normal.y);
+    if (normal.z < 0.0f)
+        square = glm::vec2((1.0f - glm::abs(normal.y)) * (normal.x < 0.0f ? -1.0f : 1.0f), (1.0f - glm::abs(normal.x)) * (normal.y < 0.0f ? -1.0f : 1.0f));
+
+    u_int16_t u = (u_int16_t)glm::clamp(std::floor(((square.x + 1.0f) * 63.5f) + 0.5f), 0.0f, 127.0f);
+    u_int16_t v = (u_int16_t)glm::clamp(std::floor(((square.y + 1.0f) * 63.5f) + 0.5f), 0.0f, 127.0f);
+    flags = (flags & 3) | (u << 2) | (v << 9);
+}
+
+glm::vec3 Photon::Normal() const
+{
+    glm::vec2 square((((flags >> 2) & 127) / 63.5f) - 1.0f, (((flags >> 9) & 127) / 63.5f) - 1.0f);
+    glm::vec3 normal(square.x, square.y, 1.0f - glm::abs(square.x) - glm::abs(square.y));
+    if (normal.z < 0.0f)
+        normal = glm::vec3((1.0f - glm::abs(square.y)) * (square.x < 0.0f ? -1.0f : 1.0f), (1.0f - glm::abs(square.x)) * (square.y < 0.0f ? -1.0f : 1.0f), normal.z);
+
+    return glm::normalize(normal);
+}
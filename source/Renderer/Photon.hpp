@@ -0,0 +1,27 @@
+#pragma once
+
+#include <sys/types.h>
+#include <glm/glm.hpp>
+
+// 20 Byte Photon: the Direction is Quantised to a Byte each of Theta and Phi, and the Power is Stored as RGBE
+struct Photon
+{
+    glm::vec3 position;
+    u_int8_t power[4]; // Red, Green and Blue Mantissas, then the Shared Exponent
+    u_int8_t theta;
+    u_int8_t phi;
+    u_int16_t flags;   // The Low Two Bits Hold the Split Axis, Set when the Photon is Placed in a PhotonKdTree, and the Rest the Surface Normal
+
+    void SetPower(glm::vec3 colour);
+    glm::vec3 Power() const;
+
+    void SetDirection(glm::vec3 direction);
+    glm::vec3 Direction() const;
+
+    // The Normal of the Surface the Photon was Stored on, Turned to the Side it Arrived from, Octahedrally Encoded in Seven Bits per Coordinate
+    void SetNormal(glm::vec3 normal);
+    glm::vec3 Normal() const;
+
+    u_int8_t splitAxis() const { return flags & 3; }
+    void SetSplitAxis(u_int8_t axis) { flags = (flags & ~3) | axis; }
+};
@@ -0,0 +1,93 @@
+#include "PhotonBVH.hpp"
+
+struct NearestPhotonQuery
+{
+    const Photon* photons;
+    PhotonGather* gather;
+};
+
+PhotonBVH::PhotonBVH() :
+    m_scene(nullptr), m_photons(std::vector<Photon>()) {}
+
+PhotonBVH::~PhotonBVH()
+{
+    if (m_scene != nullptr)
+        rtcReleaseScene(m_scene);
+}
+
+void PhotonBVH::Build(RTCDevice device, std::vector<Photon> photons)
+{
+    if (m_scene != nullptr)
+        rtcReleaseScene(m_scene);
+
+    m_photons = photons;
+    m_scene = rtcNewScene(device);
+    rtcSetSceneBuildQuality(m_scene, RTC_BUILD_QUALITY_HIGH);
+
+    RTCGeometry geometry = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_USER);
+    rtcSetGeometryUserPrimitiveCount(geometry, m_photons.size());
+    rtcSetGeometryBoundsFunction(geometry, &PhotonBVH::PhotonBounds, m_photons.data());
+    rtcCommitGeometry(geometry);
+
+    rtcAttachGeometry(m_scene, geometry);
+    rtcReleaseGeometry(geometry);
+
+    rtcCommitScene(m_scene);
+}
+
+void PhotonBVH::GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter) const
+{
+    if (filter != nullptr)
+        gather.Reset(maxNumber, maxDistance, *filter);
+    else
+        gather.Reset(maxNumber, maxDistance);
+    if (m_photons.empty() || gather.maxNumber == 0)
+        return;
+
+    NearestPhotonQuery query = { m_photons.data(), &gather };
+    PointQuery(point, maxDistance, &PhotonBVH::GatherNearest, &query);
+}
+
+void PhotonBVH::PhotonBounds(const RTCBoundsFunctionArguments* args)
+{
+    const Photon& photon = ((const Photon*)args->geometryUserPtr)[args->primID];
+
+    args->bounds_o->lower_x = args->bounds_o->upper_x = photon.position.x;
+    args->bounds_o->lower_y = args->bounds_o->upper_y = photon.position.y;
+    args->bounds_o->lower_z = args->bounds_o->upper_z = photon.position.z;
+}
+
+bool PhotonBVH::GatherNearest(RTCPointQueryFunctionArguments* args)
+{
+    NearestPhotonQuery* query = (NearestPhotonQuery*)args->userPtr;
+    PhotonGather& gather = *query->gather;
+    const Photon& photon = query->photons[args->primID];
+
+    glm::vec3 offset = photon.position - glm::vec3(args->query->x, args->query->y, args->query->z);
+    float distanceSquared = glm::dot(offset, offset);
+    if (distanceSquared >= gather.maxDistanceSquared || !gather.Accepts(photon, offset))
+        return false;
+
+    gather.Insert(&photon, distanceSquared);
+    if (gather.count < gather.maxNumber)
+        return false;
+
+    // Once Full, the Furthest Gathered Photon Bounds the Search, so Shrink the Query for the Rest of the Traversal
+    args->query->radius = glm::sqrt(gather.maxDistanceSquared);
+    return true;
+}
+
+void PhotonBVH::PointQuery(glm::vec3 point, float radius, RTCPointQueryFunction queryFunction, void* userPtr) const
+{
+    RTCPointQuery query;
+    {
+        query.x = point.x; query.y = point.y; query.z = point.z;
+        query.time = 0.0f;
+        query.radius = radius;
+    }
+
+    RTCPointQueryContext context;
+    rtcInitPointQueryContext(&context);
+
+    rtcPointQuery(m_scene, &query, &context, queryFunction, userPtr);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <embree3/rtcore.h>
+
+#include <sys/types.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Photon.hpp"
+#include "PhotonKdTree.hpp"
+
+// Embree BVH over Photon Points, Queried with rtcPointQuery
+// Each Photon is a Primitive of a User Geometry with a Degenerate Box, so Embree's Parallel SAH Builder
+// Constructs the Tree and its Vectorised Traversal Culls Nodes against the Query Sphere
+class PhotonBVH
+{
+public:
+    PhotonBVH();
+    ~PhotonBVH();
+
+private:
+    PhotonBVH(const PhotonBVH&);
+    PhotonBVH& operator=(const PhotonBVH&);
+
+    RTCScene m_scene;
+    std::vector<Photon> m_photons;
+
+public:
+    size_t size() const { return m_photons.size(); }
+    const std::vector<Photon>& photons() const { return m_photons; }
+
+    void Build(RTCDevice device, std::vector<Photon> photons);
+
+    // Collects up to maxNumber Nearest Photons within maxDistance
+    void GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter = nullptr) const;
+
+    // Calls visitor(photon, distanceSquared) for every Photon within maxDistance, in no Particular Order
+    template<typename Visitor>
+    void VisitPhotonsInRange(glm::vec3 point, float maxDistance, Visitor& visitor) const
+    {
+        if (m_photons.empty())
+            return;
+
+        RangeQuery<Visitor> range = { m_photons.data(), maxDistance * maxDistance, &visitor };
+        PointQuery(point, maxDistance, &VisitInRange<Visitor>, &range);
+    }
+
+private:
+    template<typename Visitor>
+    struct RangeQuery
+    {
+        const Photon* photons;
+        float maxDistanceSquared;
+        Visitor* visitor;
+    };
+
+    template<typename Visitor>
+    static bool VisitInRange(RTCPointQueryFunctionArguments* args)
+    {
+        RangeQuery<Visitor>* range = (RangeQuery<Visitor>*)args->userPtr;
+        const Photon& photon = range->photons[args->primID];
+
+        glm::vec3 offset = photon.position - glm::vec3(args->query->x, args->query->y, args->query->z);
+        float distanceSquared = glm::dot(offset, offset);
+        if (distanceSquared <= range->maxDistanceSquared)
+            (*range->visitor)(photon, distanceSquared);
+
+        return false;
+    }
+
+    static void PhotonBounds(const RTCBoundsFunctionArguments* args);
+    static bool GatherNearest(RTCPointQueryFunctionArguments* args);
+
+    void PointQuery(glm::vec3 point, float radius, RTCPointQueryFunction queryFunction, void* userPtr) const;
+};
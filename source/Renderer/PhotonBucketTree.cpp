@@ -0,0 +1,323 @@
+#include "PhotonBucketTree.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/constants.hpp>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+PhotonBucketTree::PhotonBucketTree() :
+    m_nodes(std::vector<BucketNode>()), m_aggregates(std::vector<NodeAggregate>()), m_buckets(std::vector<PhotonBucket>()), m_photons(std::vector<Photon>()), m_photonCount(0) {}
+
+void PhotonBucketTree::Build(std::vector<Photon> photons)
+{
+    m_nodes.clear();
+    m_aggregates.clear();
+    m_buckets.clear();
+    m_photons.clear();
+    m_photonCount = photons.size();
+
+    if (photons.empty())
+        return;
+
+    // A Balanced Tree with at most BUCKET_SIZE Photons per Leaf has Fewer than 2 * n / (BUCKET_SIZE / 2) Nodes
+    m_nodes.reserve((4 * photons.size() / BUCKET_SIZE) + 1);
+    m_aggregates.reserve(m_nodes.capacity());
+    m_buckets.reserve((2 * photons.size() / BUCKET_SIZE) + 1);
+    m_photons.reserve(((2 * photons.size() / BUCKET_SIZE) + 1) * BUCKET_SIZE);
+
+    BuildSubtree(photons, 0, photons.size());
+}
+
+void PhotonBucketTree::GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter) const
+{
+    if (filter != nullptr)
+        gather.Reset(maxNumber, maxDistance, *filter);
+    else
+        gather.Reset(maxNumber, maxDistance);
+    if (m_nodes.empty() || gather.maxNumber == 0)
+        return;
+
+    float distancesSquared[BUCKET_SIZE];
+
+    gather.traversalStack[gather.stackSize++] = std::make_pair(0u, 0.0f);
+    while (gather.stackSize > 0)
+    {
+        std::pair<u_int32_t, float> entry = gather.traversalStack[--gather.stackSize];
+        if (entry.second >= gather.maxDistanceSquared)
+            continue;
+
+        // Walk Down the Near Side to a Leaf, Deferring each Far Child until the Search Radius is Known Better
+        u_int32_t nodeIndex = entry.first;
+        while (m_nodes[nodeIndex].axis != LEAF_NODE)
+        {
+            const BucketNode& node = m_nodes[nodeIndex];
+            float planeDistance = point[node.axis] - node.splitPosition;
+            u_int32_t nearChild = planeDistance < 0.0f ? nodeIndex + 1 : node.child;
+            u_int32_t farChild = planeDistance < 0.0f ? node.child : nodeIndex + 1;
+
+            float farDistanceSquared = gather.PlaneDistanceSquared(node.axis, planeDistance);
+            if (farDistanceSquared < gather.maxDistanceSquared)
+                gather.traversalStack[gather.stackSize++] = std::make_pair(farChild, farDistanceSquared);
+            nodeIndex = nearChild;
+        }
+
+        // The Bucket's Distances come from one Vector Pass; only the Slots it Flags are Offered to the Gather,
+        // which is Checked again per Slot as each Insert can Shrink the Radius
+        const BucketNode& leaf = m_nodes[nodeIndex];
+        u_int32_t hits = ScanBucket(leaf, point, gather.maxDistanceSquared, distancesSquared);
+        while (hits != 0)
+        {
+            u_int32_t slot = __builtin_ctz(hits);
+            hits &= hits - 1;
+
+            const Photon& photon = m_photons[(leaf.child * BUCKET_SIZE) + slot];
+            if (distancesSquared[slot] < gather.maxDistanceSquared && gather.Accepts(photon, photon.position - point))
+                gather.Insert(&photon, distancesSquared[slot]);
+        }
+    }
+}
+
+u_int32_t PhotonBucketTree::GatherFacingPower(glm::vec3 point, float maxDistance, glm::vec3 normal, glm::vec3& power) const
+{
+    power = glm::vec3(0.0f, 0.0f, 0.0f);
+    float normalLength = glm::length(normal);
+    if (m_nodes.empty() || normalLength == 0.0f)
+        return 0;
+
+    // Cones within this much of the Horizon are Opened, so Rounding in the Angles never Decides a Photon's Facing
+    const float horizonAngle = glm::half_pi<float>();
+    const float horizonMargin = 1e-3f;
+
+    float maxDistanceSquared = maxDistance * maxDistance;
+    float distancesSquared[BUCKET_SIZE];
+    u_int32_t photonCount = 0;
+
+    u_int32_t stack[MAX_TRAVERSAL_DEPTH];
+    u_int32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        u_int32_t nodeIndex = stack[--stackSize];
+        const NodeAggregate& aggregate = m_aggregates[nodeIndex];
+
+        glm::vec3 nearOffset = glm::max(glm::max(aggregate.lowerBound - point, point - aggregate.upperBound), glm::vec3(0.0f, 0.0f, 0.0f));
+        if (glm::dot(nearOffset, nearOffset) > maxDistanceSquared)
+            continue;
+
+        float normalAngle = glm::acos(glm::clamp(glm::dot(aggregate.coneAxis, normal) / normalLength, -1.0f, 1.0f));
+        if (normalAngle - aggregate.coneAngle > horizonAngle + horizonMargin)
+            continue;
+
+        glm::vec3 farOffset = glm::max(glm::abs(aggregate.lowerBound - point), glm::abs(aggregate.upperBound - point));
+        if (glm::dot(farOffset, farOffset) <= maxDistanceSquared && normalAngle + aggregate.coneAngle < horizonAngle - horizonMargin)
+        {
+            power += glm::vec3(glm::dot(aggregate.directedPower[0], normal), glm::dot(aggregate.directedPower[1], normal), glm::dot(aggregate.directedPower[2], normal));
+            photonCount += aggregate.count;
+            continue;
+        }
+
+        const BucketNode& node = m_nodes[nodeIndex];
+        if (node.axis != LEAF_NODE)
+        {
+            stack[stackSize++] = node.child;
+            stack[stackSize++] = nodeIndex + 1;
+            continue;
+        }
+
+        u_int32_t hits = ScanBucket(node, point, maxDistanceSquared, distancesSquared);
+        while (hits != 0)
+        {
+            u_int32_t slot = __builtin_ctz(hits);
+            hits &= hits - 1;
+
+            const Photon& photon = m_photons[(node.child * BUCKET_SIZE) + slot];
+            float facingRatio = glm::dot(photon.Direction(), normal);
+            if (facingRatio <= 0.0f)
+                continue;
+
+            power += photon.Power() * facingRatio;
+            photonCount++;
+        }
+    }
+
+    return photonCount;
+}
+
+u_int32_t PhotonBucketTree::BuildSubtree(std::vector<Photon>& photons, u_int32_t begin, u_int32_t end)
+{
+    u_int32_t nodeIndex = m_nodes.size();
+    m_nodes.push_back(BucketNode());
+    m_aggregates.push_back(NodeAggregate());
+
+    if (end - begin <= BUCKET_SIZE)
+    {
+        // Empty Slots are Parked Infinitely Far Away, so Scans need no Count
+        PhotonBucket bucket;
+        for (u_int32_t i = 0; i < BUCKET_SIZE; i++)
+        {
+            glm::vec3 position = (begin + i < end) ? photons[begin + i].position : glm::vec3(std::numeric_limits<float>().infinity());
+            bucket.x[i] = position.x;
+            bucket.y[i] = position.y;
+            bucket.z[i] = position.z;
+        }
+
+        BucketNode& leaf = m_nodes[nodeIndex];
+        {
+            leaf.splitPosition = 0.0f;
+            leaf.axis = LEAF_NODE;
+            leaf.child = m_buckets.size();
+            leaf.count = end - begin;
+        }
+        m_buckets.push_back(bucket);
+        AggregateLeaf(nodeIndex, photons, begin, end);
+
+        m_photons.insert(m_photons.end(), photons.begin() + begin, photons.begin() + end);
+        m_photons.resize(m_buckets.size() * BUCKET_SIZE, photons[begin]);
+        return nodeIndex;
+    }
+
+    // Split along the Longest Side of the Subtree's Bounds, at the Median so Leaves End up between Half and Fully Occupied
+    glm::vec3 lowerBound = photons[begin].position;
+    glm::vec3 upperBound = photons[begin].position;
+    for (u_int32_t i = begin + 1; i < end; i++)
+    {
+        lowerBound = glm::min(lowerBound, photons[i].position);
+        upperBound = glm::max(upperBound, photons[i].position);
+    }
+    glm::vec3 extent = upperBound - lowerBound;
+
+    u_int32_t axis = 0;
+    if (extent.y > extent[axis])
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    u_int32_t median = begin + ((end - begin) / 2);
+    std::nth_element(photons.begin() + begin, photons.begin() + median, photons.begin() + end,
+        [axis](const Photon& a, const Photon& b) { return a.position[axis] < b.position[axis]; });
+    float splitPosition = photons[median].position[axis];
+
+    BuildSubtree(photons, begin, median);
+    u_int32_t rightChild = BuildSubtree(photons, median, end);
+
+    BucketNode& node = m_nodes[nodeIndex];
+    {
+        node.splitPosition = splitPosition;
+        node.axis = axis;
+        node.child = rightChild;
+        node.count = 0;
+    }
+    AggregateChildren(nodeIndex);
+    return nodeIndex;
+}
+
+void PhotonBucketTree::AggregateLeaf(u_int32_t nodeIndex, const std::vector<Photon>& photons, u_int32_t begin, u_int32_t end)
+{
+    NodeAggregate& aggregate = m_aggregates[nodeIndex];
+    aggregate.lowerBound = photons[begin].position;
+    aggregate.upperBound = photons[begin].position;
+    aggregate.directedPower[0] = aggregate.directedPower[1] = aggregate.directedPower[2] = glm::vec3(0.0f, 0.0f, 0.0f);
+    aggregate.count = end - begin;
+
+    // Directions are Decoded as Gathers See them, so the Cone Bounds Exactly what a Photon-by-Photon Gather would Test
+    glm::vec3 directionSum(0.0f, 0.0f, 0.0f);
+    for (u_int32_t i = begin; i < end; i++)
+    {
+        glm::vec3 direction = photons[i].Direction();
+        glm::vec3 power = photons[i].Power();
+
+        aggregate.lowerBound = glm::min(aggregate.lowerBound, photons[i].position);
+        aggregate.upperBound = glm::max(aggregate.upperBound, photons[i].position);
+        for (u_int32_t c = 0; c < 3; c++)
+            aggregate.directedPower[c] += direction * power[c];
+        directionSum += direction;
+    }
+
+    float sumLength = glm::length(directionSum);
+    aggregate.coneAxis = (sumLength > 1e-6f) ? directionSum / sumLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    aggregate.coneAngle = (sumLength > 1e-6f) ? 0.0f : glm::pi<float>();
+    for (u_int32_t i = begin; i < end && aggregate.coneAngle < glm::pi<float>(); i++)
+        aggregate.coneAngle = glm::max(aggregate.coneAngle, glm::acos(glm::clamp(glm::dot(aggregate.coneAxis, photons[i].Direction()), -1.0f, 1.0f)));
+}
+
+void PhotonBucketTree::AggregateChildren(u_int32_t nodeIndex)
+{
+    const NodeAggregate& left = m_aggregates[nodeIndex + 1];
+    const NodeAggregate& right = m_aggregates[m_nodes[nodeIndex].child];
+
+    NodeAggregate& aggregate = m_aggregates[nodeIndex];
+    aggregate.lowerBound = glm::min(left.lowerBound, right.lowerBound);
+    aggregate.upperBound = glm::max(left.upperBound, right.upperBound);
+    for (u_int32_t c = 0; c < 3; c++)
+        aggregate.directedPower[c] = left.directedPower[c] + right.directedPower[c];
+    aggregate.count = left.count + right.count;
+
+    // The Parent's Cone is Centred between its Children's, Weighted by their Photons, and Widened to Enclose both
+    glm::vec3 axisSum = (left.coneAxis * (float)left.count) + (right.coneAxis * (float)right.count);
+    float sumLength = glm::length(axisSum);
+    if (sumLength <= 1e-6f || left.coneAngle >= glm::pi<float>() || right.coneAngle >= glm::pi<float>())
+    {
+        aggregate.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        aggregate.coneAngle = glm::pi<float>();
+        return;
+    }
+
+    aggregate.coneAxis = axisSum / sumLength;
+    float leftAngle = glm::acos(glm::clamp(glm::dot(aggregate.coneAxis, left.coneAxis), -1.0f, 1.0f)) + left.coneAngle;
+    float rightAngle = glm::acos(glm::clamp(glm::dot(aggregate.coneAxis, right.coneAxis), -1.0f, 1.0f)) + right.coneAngle;
+    aggregate.coneAngle = glm::min(glm::max(leftAngle, rightAngle), glm::pi<float>());
+}
+
+u_int32_t PhotonBucketTree::ScanBucket(const BucketNode& leaf, glm::vec3 point, float maxDistanceSquared, float* distancesSquared) const
+{
+    const PhotonBucket& bucket = m_buckets[leaf.child];
+    u_int32_t hits = 0;
+
+#if defined(__AVX512F__)
+    __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(bucket.x), _mm512_set1_ps(point.x));
+    __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(bucket.y), _mm512_set1_ps(point.y));
+    __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(bucket.z), _mm512_set1_ps(point.z));
+    // Summed in the Same Order as glm::dot, without Fused Multiply-Adds, so every Width Finds the Same Photons as the other Backends
+    __m512 distanceSquared = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+
+    _mm512_storeu_ps(distancesSquared, distanceSquared);
+    hits = _mm512_cmp_ps_mask(distanceSquared, _mm512_set1_ps(maxDistanceSquared), _CMP_LE_OQ);
+#elif defined(__AVX__)
+    for (u_int32_t i = 0; i < BUCKET_SIZE; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(bucket.x + i), _mm256_set1_ps(point.x));
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(bucket.y + i), _mm256_set1_ps(point.y));
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(bucket.z + i), _mm256_set1_ps(point.z));
+        __m256 distanceSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+        _mm256_storeu_ps(distancesSquared + i, distanceSquared);
+        hits |= (u_int32_t)_mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, _mm256_set1_ps(maxDistanceSquared), _CMP_LE_OQ)) << i;
+    }
+#elif defined(__SSE2__)
+    for (u_int32_t i = 0; i < BUCKET_SIZE; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(bucket.x + i), _mm_set1_ps(point.x));
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(bucket.y + i), _mm_set1_ps(point.y));
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(bucket.z + i), _mm_set1_ps(point.z));
+        __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        _mm_storeu_ps(distancesSquared + i, distanceSquared);
+        hits |= (u_int32_t)_mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(maxDistanceSquared))) << i;
+    }
+#else
+    for (u_int32_t i = 0; i < BUCKET_SIZE; i++)
+    {
+        float dx = bucket.x[i] - point.x, dy = bucket.y[i] - point.y, dz = bucket.z[i] - point.z;
+        distancesSquared[i] = (dx * dx) + (dy * dy) + (dz * dz);
+        if (distancesSquared[i] <= maxDistanceSquared)
+            hits |= 1u << i;
+    }
+#endif
+
+    return hits & ((1u << leaf.count) - 1);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <sys/types.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Photon.hpp"
+#include "PhotonKdTree.hpp"
+
+#define BUCKET_SIZE 16    // Photon Slots per Leaf; Leaves are Split until they Hold at most this Many, so Hold 8 to 16
+#define LEAF_NODE 3       // Axis Value Marking a Leaf
+
+// Kd-Tree whose Leaves are Buckets of up to 16 Photons, with the Bucket's Positions Stored as Separate x, y and z Arrays
+// A Leaf's Distances are Computed for the whole Bucket at once with the Widest Vector Instructions the Build Targets,
+// so the Tree is Four Levels Shallower than a Photon-per-Node Kd-Tree and most Distance Work is Vectorised
+class PhotonBucketTree
+{
+public:
+    PhotonBucketTree();
+
+private:
+    struct BucketNode
+    {
+        float splitPosition;
+        u_int32_t axis;  // LEAF_NODE for Leaves
+        u_int32_t child; // Inner Nodes: the Right Child, as the Left Follows Directly; Leaves: the Bucket
+        u_int32_t count; // Leaves: how many of the Bucket's Slots Hold Photons
+    };
+
+    struct PhotonBucket
+    {
+        float x[BUCKET_SIZE];
+        float y[BUCKET_SIZE];
+        float z[BUCKET_SIZE];
+    };
+
+    // Summary of a Subtree's Photons, so a Range Gather can Take a whole Subtree at once
+    struct NodeAggregate
+    {
+        glm::vec3 lowerBound;
+        glm::vec3 upperBound;
+        glm::vec3 directedPower[3]; // Per Colour Channel, the Sum of each Photon's Power in that Channel times its Direction
+        glm::vec3 coneAxis;         // Every Photon's Direction is within coneAngle of coneAxis
+        float coneAngle;
+        u_int32_t count;
+    };
+
+    std::vector<BucketNode> m_nodes;
+    std::vector<NodeAggregate> m_aggregates; // One per Node, in the Same Order
+    std::vector<PhotonBucket> m_buckets;
+    std::vector<Photon> m_photons; // In Bucket Order, BUCKET_SIZE Slots per Bucket, so Photon i of Bucket b is m_photons[(b * BUCKET_SIZE) + i]
+    u_int32_t m_photonCount;
+
+public:
+    size_t size() const { return m_photonCount; }
+
+    void Build(std::vector<Photon> photons);
+
+    // Collects up to maxNumber Nearest Photons within maxDistance
+    void GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter = nullptr) const;
+
+    // Sums the Power, times its Facing Ratio, of every Photon within maxDistance Arriving on a Surface with this Normal, and Returns how Many there were
+    // A Subtree Wholly within Range whose Directions all Face the Normal is Taken from its Aggregate, and one whose Directions all Face Away is Skipped,
+    // so only Subtrees Crossing the Range's Boundary or the Surface's Horizon are Opened
+    u_int32_t GatherFacingPower(glm::vec3 point, float maxDistance, glm::vec3 normal, glm::vec3& power) const;
+
+    // Calls visitor(photon, distanceSquared) for every Photon within maxDistance, in no Particular Order
+    template<typename Visitor>
+    void VisitPhotonsInRange(glm::vec3 point, float maxDistance, Visitor& visitor) const
+    {
+        if (m_nodes.empty())
+            return;
+
+        float maxDistanceSquared = maxDistance * maxDistance;
+        float distancesSquared[BUCKET_SIZE];
+
+        u_int32_t stack[MAX_TRAVERSAL_DEPTH];
+        u_int32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            u_int32_t nodeIndex = stack[--stackSize];
+            while (m_nodes[nodeIndex].axis != LEAF_NODE)
+            {
+                const BucketNode& node = m_nodes[nodeIndex];
+                float planeDistance = point[node.axis] - node.splitPosition;
+                u_int32_t nearChild = planeDistance < 0.0f ? nodeIndex + 1 : node.child;
+                u_int32_t farChild = planeDistance < 0.0f ? node.child : nodeIndex + 1;
+
+                if (planeDistance * planeDistance <= maxDistanceSquared)
+                    stack[stackSize++] = farChild;
+                nodeIndex = nearChild;
+            }
+
+            const BucketNode& leaf = m_nodes[nodeIndex];
+            u_int32_t hits = ScanBucket(leaf, point, maxDistanceSquared, distancesSquared);
+            while (hits != 0)
+            {
+                u_int32_t slot = __builtin_ctz(hits);
+                hits &= hits - 1;
+                visitor(m_photons[(leaf.child * BUCKET_SIZE) + slot], distancesSquared[slot]);
+            }
+        }
+    }
+
+private:
+    u_int32_t BuildSubtree(std::vector<Photon>& photons, u_int32_t begin, u_int32_t end);
+    void AggregateLeaf(u_int32_t nodeIndex, const std::vector<Photon>& photons, u_int32_t begin, u_int32_t end);
+    void AggregateChildren(u_int32_t nodeIndex);
+
+    // Writes the Squared Distance of every Slot in the Leaf's Bucket, and Returns a Bit per Photon no Further than maxDistanceSquared,
+    // Including the Boundary as every other Backend's Range Visits do
+    // Empty Slots Sit Infinitely Far Away, and are Masked off by the Leaf's Count, so even an Infinite Range never Reaches them
+    u_int32_t ScanBucket(const BucketNode& leaf, glm::vec3 point, float maxDistanceSquared, float* distancesSquared) const;
+};
@@ -0,0 +1,75 @@
+#include "PhotonForest.hpp"
+
+PhotonForest::PhotonForest() :
+    m_trees(std::vector<PhotonKdTree>()), m_photonCount(0) {}
+
+void PhotonForest::Clear()
+{
+    m_trees.clear();
+    m_photonCount = 0;
+}
+
+void PhotonForest::Insert(std::vector<Photon> photons, ThreadPool* threadPool)
+{
+    if (photons.empty())
+        return;
+
+    m_photonCount += photons.size();
+    m_trees.push_back(PhotonKdTree());
+    m_trees.back().Build(photons, threadPool);
+
+    // Like Carrying in a Binary Counter: a Merge can Leave the New Last Tree Close in Size to the one before it too
+    while (m_trees.size() >= 2 && m_trees[m_trees.size() - 2].size() <= FOREST_MERGE_RATIO * m_trees.back().size())
+        MergeLastTrees(threadPool);
+}
+
+void PhotonForest::Attach(const Photon* nodes, u_int32_t nodeCount)
+{
+    Clear();
+    if (nodeCount == 0)
+        return;
+
+    m_photonCount = nodeCount;
+    m_trees.push_back(PhotonKdTree());
+    m_trees.back().Attach(nodes, nodeCount);
+}
+
+const PhotonKdTree& PhotonForest::MergedTree(PhotonKdTree& scratchTree) const
+{
+    if (m_trees.size() == 1)
+        return m_trees[0];
+
+    std::vector<Photon> photons;
+    photons.reserve(m_photonCount);
+    for (const PhotonKdTree& photonTree : m_trees)
+        photons.insert(photons.end(), photonTree.nodes(), photonTree.nodes() + photonTree.size());
+
+    scratchTree.Build(photons);
+    return scratchTree;
+}
+
+void PhotonForest::GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter) const
+{
+    if (filter != nullptr)
+        gather.Reset(maxNumber, maxDistance, *filter);
+    else
+        gather.Reset(maxNumber, maxDistance);
+
+    for (const PhotonKdTree& photonTree : m_trees)
+        photonTree.SearchNearestPhotons(point, gather);
+}
+
+void PhotonForest::MergeLastTrees(ThreadPool* threadPool)
+{
+    // Tree Nodes are the Photons themselves, so the two Node Arrays are Rebuilt as one
+    const PhotonKdTree& olderTree = m_trees[m_trees.size() - 2];
+    const PhotonKdTree& newerTree = m_trees.back();
+
+    std::vector<Photon> photons;
+    photons.reserve(olderTree.size() + newerTree.size());
+    photons.insert(photons.end(), olderTree.nodes(), olderTree.nodes() + olderTree.size());
+    photons.insert(photons.end(), newerTree.nodes(), newerTree.nodes() + newerTree.size());
+
+    m_trees.pop_back();
+    m_trees.back().Build(photons, threadPool);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sys/types.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Photon.hpp"
+#include "PhotonKdTree.hpp"
+#include "ThreadPool.hpp"
+
+#define FOREST_MERGE_RATIO 2 // A Tree is Merged into the one before it while that one is at most this many times Larger
+
+// Append-Only Photon Index: a Logarithmic Forest of Static Kd-Trees (Bentley and Saxe 1980)
+// Each Inserted Batch becomes a Tree of its own, and Trees of Similar Size are Merged, so the Forest Holds O(log n) Trees
+// and each Photon is Rebuilt O(log n) Times however the Photons Arrive, rather than once per Batch
+class PhotonForest
+{
+public:
+    PhotonForest();
+
+private:
+    std::vector<PhotonKdTree> m_trees; // Largest First
+    size_t m_photonCount;
+
+public:
+    size_t size() const { return m_photonCount; }
+    u_int32_t treeCount() const { return m_trees.size(); }
+    const PhotonKdTree& tree(u_int32_t index) const { return m_trees[index]; }
+
+    void Clear();
+    // The New Photons are Searchable once this Returns; a ThreadPool, if Given, Builds the Trees in Parallel
+    void Insert(std::vector<Photon> photons, ThreadPool* threadPool = nullptr);
+    // Replaces the Forest with one Tree Served from Nodes a previous Build Laid Out
+    void Attach(const Photon* nodes, u_int32_t nodeCount);
+
+    // The Forest as a Single Kd-Tree: its only Tree, or every Tree Merged into scratchTree
+    const PhotonKdTree& MergedTree(PhotonKdTree& scratchTree) const;
+
+    // Collects up to maxNumber Nearest Photons within maxDistance across every Tree
+    // The Largest Tree is Searched First, so the Radius has mostly Shrunk before the Smaller Trees are Reached
+    void GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter = nullptr) const;
+
+    // Calls visitor(photon, distanceSquared) for every Photon within maxDistance, in no Particular Order
+    template<typename Visitor>
+    void VisitPhotonsInRange(glm::vec3 point, float maxDistance, Visitor& visitor) const
+    {
+        for (const PhotonKdTree& photonTree : m_trees)
+            photonTree.VisitPhotonsInRange(point, maxDistance, visitor);
+    }
+
+private:
+    void MergeLastTrees(ThreadPool* threadPool);
+};
@@ -0,0 +1,119 @@
+#include "PhotonHashGrid.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "Morton.hpp"
+
+#define EMPTY_CELL_KEY (~0ull)
+
+struct NearestPhotonVisitor
+{
+    PhotonGather& gather;
+    glm::vec3 point;
+
+    void operator()(const Photon& photon, float distanceSquared)
+    {
+        // The Gather Tightens its own Radius once Full
+        if (distanceSquared < gather.maxDistanceSquared && gather.Accepts(photon, photon.position - point))
+            gather.Insert(&photon, distanceSquared);
+    }
+};
+
+PhotonHashGrid::PhotonHashGrid() :
+    m_photons(std::vector<Photon>()), m_cells(std::vector<GridCell>()),
+    m_gatherRadius(0.0f), m_inverseCellSize(0.0f), m_cellMask(0) {}
+
+void PhotonHashGrid::Build(std::vector<Photon> photons, float gatherRadius)
+{
+    m_gatherRadius = gatherRadius;
+    m_inverseCellSize = 1.0f / (2.0f * gatherRadius);
+
+    // Sorting by Cell Key Groups each Cell's Photons, and the Key's Morton Order keeps Neighbouring Cells Nearby
+    std::vector<std::pair<u_int64_t, u_int32_t>> sortedKeys = std::vector<std::pair<u_int64_t, u_int32_t>>(photons.size());
+    for (u_int32_t i = 0; i < photons.size(); i++)
+    {
+        glm::vec3 position = photons[i].position;
+        sortedKeys[i] = std::make_pair(CellKey(CellCoordinate(position.x), CellCoordinate(position.y), CellCoordinate(position.z)), i);
+    }
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+
+    m_photons.resize(photons.size());
+    u_int32_t cellCount = 0;
+    for (u_int32_t i = 0; i < sortedKeys.size(); i++)
+    {
+        m_photons[i] = photons[sortedKeys[i].second];
+        if (i == 0 || sortedKeys[i].first != sortedKeys[i - 1].first)
+            cellCount++;
+    }
+
+    // At most Half Full, so Probes for Empty Cells End Quickly
+    u_int32_t tableSize = 1;
+    while (tableSize < cellCount * 2)
+        tableSize *= 2;
+    m_cellMask = tableSize - 1;
+
+    GridCell emptyCell;
+    {
+        emptyCell.cellKey = EMPTY_CELL_KEY;
+        emptyCell.begin = 0;
+        emptyCell.end = 0;
+    }
+    m_cells.assign(tableSize, emptyCell);
+
+    u_int32_t begin = 0;
+    while (begin < sortedKeys.size())
+    {
+        u_int32_t end = begin + 1;
+        while (end < sortedKeys.size() && sortedKeys[end].first == sortedKeys[begin].first)
+            end++;
+
+        u_int32_t slot = CellSlot(sortedKeys[begin].first);
+        while (m_cells[slot].cellKey != EMPTY_CELL_KEY)
+            slot = (slot + 1) & m_cellMask;
+
+        m_cells[slot].cellKey = sortedKeys[begin].first;
+        m_cells[slot].begin = begin;
+        m_cells[slot].end = end;
+
+        begin = end;
+    }
+}
+
+void PhotonHashGrid::GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter) const
+{
+    maxDistance = glm::min(maxDistance, m_gatherRadius);
+    if (filter != nullptr)
+        gather.Reset(maxNumber, maxDistance, *filter);
+    else
+        gather.Reset(maxNumber, maxDistance);
+    if (m_photons.empty() || gather.maxNumber == 0)
+        return;
+
+    NearestPhotonVisitor visitor = { gather, point };
+    VisitPhotonsInRange(point, maxDistance, visitor);
+}
+
+u_int64_t PhotonHashGrid::CellKey(int32_t x, int32_t y, int32_t z)
+{
+    // Morton Code of the Cell, 21 Bits per Axis, Enough for any Scene the Renderer can Represent at Photon Scale
+    return MortonCode((u_int32_t)x, (u_int32_t)y, (u_int32_t)z);
+}
+
+u_int32_t PhotonHashGrid::CellSlot(u_int64_t cellKey) const
+{
+    // Fibonacci Hashing, as Morton Codes of Nearby Cells Differ only in their Low Bits
+    return (u_int32_t)((cellKey * 0x9E3779B97F4A7C15ull) >> 32) & m_cellMask;
+}
+
+const PhotonHashGrid::GridCell* PhotonHashGrid::FindCell(u_int64_t cellKey) const
+{
+    u_int32_t slot = CellSlot(cellKey);
+    while (m_cells[slot].cellKey != EMPTY_CELL_KEY)
+    {
+        if (m_cells[slot].cellKey == cellKey)
+            return &m_cells[slot];
+        slot = (slot + 1) & m_cellMask;
+    }
+    return nullptr;
+}
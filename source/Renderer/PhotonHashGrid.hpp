@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sys/types.h>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Photon.hpp"
+#include "PhotonKdTree.hpp"
+
+// Uniform Grid of Cells for Fixed-Radius Photon Gathers, with only the Occupied Cells Stored in a Hash Table
+// Cells are Twice the Gather Radius, so a Gather Touches at most 2x2x2 Cells,
+// and Photons are Sorted by Cell in Morton Order, so each Cell is one Contiguous Run and Neighbouring Cells are Close in Memory
+class PhotonHashGrid
+{
+public:
+    PhotonHashGrid();
+
+private:
+    struct GridCell
+    {
+        u_int64_t cellKey;
+        u_int32_t begin;
+        u_int32_t end;
+    };
+
+    std::vector<Photon> m_photons;
+    std::vector<GridCell> m_cells; // Open Addressing with Linear Probing, Empty Slots have EMPTY_CELL_KEY
+
+    float m_gatherRadius;
+    float m_inverseCellSize;
+    u_int32_t m_cellMask;
+
+public:
+    size_t size() const { return m_photons.size(); }
+    const std::vector<Photon>& photons() const { return m_photons; }
+    float gatherRadius() const { return m_gatherRadius; }
+
+    void Build(std::vector<Photon> photons, float gatherRadius);
+
+    // Collects up to maxNumber Nearest Photons within maxDistance, which is Clamped to the Grid's Gather Radius
+    void GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter = nullptr) const;
+
+    // Calls visitor(photon, distanceSquared) for every Photon within maxDistance, in no Particular Order
+    template<typename Visitor>
+    void VisitPhotonsInRange(glm::vec3 point, float maxDistance, Visitor& visitor) const
+    {
+        if (m_photons.empty())
+            return;
+
+        float maxDistanceSquared = maxDistance * maxDistance;
+        int32_t lower[3], upper[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            lower[axis] = CellCoordinate(point[axis] - maxDistance);
+            upper[axis] = CellCoordinate(point[axis] + maxDistance);
+        }
+
+        for (int32_t z = lower[2]; z <= upper[2]; z++)
+        for (int32_t y = lower[1]; y <= upper[1]; y++)
+        for (int32_t x = lower[0]; x <= upper[0]; x++)
+        {
+            const GridCell* cell = FindCell(CellKey(x, y, z));
+            if (cell == nullptr)
+                continue;
+
+            for (u_int32_t i = cell->begin; i < cell->end; i++)
+            {
+                glm::vec3 offset = m_photons[i].position - point;
+                float distanceSquared = glm::dot(offset, offset);
+                if (distanceSquared <= maxDistanceSquared)
+                    visitor(m_photons[i], distanceSquared);
+            }
+        }
+    }
+
+private:
+    int32_t CellCoordinate(float position) const { return (int32_t)std::floor(position * m_inverseCellSize); }
+    static u_int64_t CellKey(int32_t x, int32_t y, int32_t z);
+    u_int32_t CellSlot(u_int64_t cellKey) const;
+    const GridCell* FindCell(u_int64_t cellKey) const;
+};
@@ -0,0 +1,281 @@
+#include "PhotonKdTree.hpp"
+
+#include <algorithm>
+#include <limits>
+
+static bool CompareGatheredPhotons(const GatheredPhoton& a, const GatheredPhoton& b)
+{
+    return a.distanceSquared < b.distanceSquared;
+}
+
+SurfaceFilter::SurfaceFilter() :
+    normal(0.0f, 0.0f, 1.0f), discThickness(0.0f), axisSpread(), axisThickness() {}
+
+SurfaceFilter::SurfaceFilter(glm::vec3 normal, float discThickness) :
+    normal(normal), discThickness(discThickness)
+{
+    // A Disc of Radius r and Half-Thickness t about Normal n Reaches r * sqrt(1 - n_a^2) + t * |n_a| along Axis a
+    for (u_int32_t axis = 0; axis < 3; axis++)
+    {
+        axisSpread[axis] = glm::sqrt(glm::max(0.0f, 1.0f - (normal[axis] * normal[axis])));
+        axisThickness[axis] = discThickness * glm::abs(normal[axis]);
+    }
+}
+
+float SurfaceFilter::PlaneDistanceSquared(u_int8_t axis, float planeDistance) const
+{
+    planeDistance = glm::abs(planeDistance);
+    if (planeDistance <= axisThickness[axis])
+        return planeDistance * planeDistance;
+
+    // The Disc Lies Flat against the Plane, so no Radius Reaches it
+    if (axisSpread[axis] < 1e-6f)
+        return std::numeric_limits<float>().infinity();
+
+    // The Sphere Reaches the Plane at planeDistance, and the Disc at (planeDistance - axisThickness) / axisSpread, whichever is Further
+    float discDistance = glm::max(planeDistance, (planeDistance - axisThickness[axis]) / axisSpread[axis]);
+    return discDistance * discDistance;
+}
+
+PhotonGather::PhotonGather() :
+    maxNumber(0), count(0), maxDistanceSquared(0.0f), stackSize(0), filtered(false), filter() {}
+
+void PhotonGather::Reset(u_int32_t maxNumber, float maxDistance)
+{
+    this->maxNumber = glm::min(maxNumber, (u_int32_t)MAX_GATHER_PHOTONS);
+    count = 0;
+    maxDistanceSquared = maxDistance * maxDistance;
+    stackSize = 0;
+    filtered = false;
+}
+
+void PhotonGather::Reset(u_int32_t maxNumber, float maxDistance, const SurfaceFilter& filter)
+{
+    Reset(maxNumber, maxDistance);
+    filtered = true;
+    this->filter = filter;
+}
+
+void PhotonGather::Insert(const Photon* photon, float distanceSquared)
+{
+    GatheredPhoton neighbour;
+    {
+        neighbour.distanceSquared = distanceSquared;
+        neighbour.photon = photon;
+    }
+
+    if (count < maxNumber)
+    {
+        neighbours[count++] = neighbour;
+        std::push_heap(neighbours, neighbours + count, CompareGatheredPhotons);
+    }
+    else
+    {
+        std::pop_heap(neighbours, neighbours + count, CompareGatheredPhotons);
+        neighbours[count - 1] = neighbour;
+        std::push_heap(neighbours, neighbours + count, CompareGatheredPhotons);
+    }
+
+    if (count == maxNumber)
+        maxDistanceSquared = neighbours[0].distanceSquared;
+}
+
+float PhotonGather::furthestDistance() const
+{
+    if (count == 0)
+        return 0.0f;
+
+    return glm::sqrt(neighbours[0].distanceSquared);
+}
+
+PhotonKdTree::PhotonKdTree() :
+    m_builtNodes(std::vector<Photon>()), m_nodes(nullptr), m_nodeCount(0) {}
+
+PhotonKdTree::PhotonKdTree(PhotonKdTree&& other) noexcept :
+    m_builtNodes(std::vector<Photon>()), m_nodes(nullptr), m_nodeCount(0)
+{
+    *this = std::move(other);
+}
+
+PhotonKdTree& PhotonKdTree::operator=(PhotonKdTree&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    bool attached = other.m_nodes != other.m_builtNodes.data();
+    m_builtNodes = std::move(other.m_builtNodes);
+    m_nodes = attached ? other.m_nodes : m_builtNodes.data();
+    m_nodeCount = other.m_nodeCount;
+
+    other.m_builtNodes.clear();
+    other.m_nodes = nullptr;
+    other.m_nodeCount = 0;
+    return *this;
+}
+
+void PhotonKdTree::Build(std::vector<Photon> photons, ThreadPool* threadPool)
+{
+    m_builtNodes.resize(photons.size());
+    if (threadPool != nullptr && photons.size() >= PARALLEL_BUILD_THRESHOLD)
+        BuildParallel(photons, threadPool);
+    else
+        BuildSubtree(photons, 0, photons.size(), 0);
+
+    m_nodes = m_builtNodes.data();
+    m_nodeCount = m_builtNodes.size();
+}
+
+void PhotonKdTree::Attach(const Photon* nodes, u_int32_t nodeCount)
+{
+    m_builtNodes.clear();
+    m_builtNodes.shrink_to_fit();
+
+    m_nodes = nodes;
+    m_nodeCount = nodeCount;
+}
+
+void PhotonKdTree::GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter) const
+{
+    if (filter != nullptr)
+        gather.Reset(maxNumber, maxDistance, *filter);
+    else
+        gather.Reset(maxNumber, maxDistance);
+
+    SearchNearestPhotons(point, gather);
+}
+
+void PhotonKdTree::SearchNearestPhotons(glm::vec3 point, PhotonGather& gather) const
+{
+    if (m_nodeCount == 0 || gather.maxNumber == 0)
+        return;
+
+    gather.traversalStack[gather.stackSize++] = std::make_pair(0u, 0.0f);
+    while (gather.stackSize > 0)
+    {
+        std::pair<u_int32_t, float> entry = gather.traversalStack[--gather.stackSize];
+        if (entry.second >= gather.maxDistanceSquared)
+            continue;
+
+        // Walk Down the Near Side, Deferring each Far Child until the Search Radius is Known Better
+        u_int32_t nodeIndex = entry.first;
+        while (true)
+        {
+            const Photon& photon = m_nodes[nodeIndex];
+
+            glm::vec3 offset = photon.position - point;
+            float distanceSquared = glm::dot(offset, offset);
+            if (distanceSquared < gather.maxDistanceSquared && gather.Accepts(photon, offset))
+                gather.Insert(&photon, distanceSquared);
+
+            u_int32_t leftChild = (2 * nodeIndex) + 1;
+            if (leftChild >= m_nodeCount)
+                break;
+
+            float planeDistance = point[photon.splitAxis()] - photon.position[photon.splitAxis()];
+            u_int32_t nearChild = planeDistance < 0.0f ? leftChild : leftChild + 1;
+            u_int32_t farChild = planeDistance < 0.0f ? leftChild + 1 : leftChild;
+
+            float farDistanceSquared = gather.PlaneDistanceSquared(photon.splitAxis(), planeDistance);
+            if (farChild < m_nodeCount && farDistanceSquared < gather.maxDistanceSquared)
+                gather.traversalStack[gather.stackSize++] = std::make_pair(farChild, farDistanceSquared);
+
+            if (nearChild >= m_nodeCount)
+                break;
+            nodeIndex = nearChild;
+        }
+    }
+}
+
+void PhotonKdTree::BuildParallel(std::vector<Photon>& photons, ThreadPool* threadPool)
+{
+    // Subtrees Share Nothing but Disjoint Ranges of photons and m_builtNodes, so each Level's Nodes can be Split at once
+    // Splitting Stops once there are Enough Subtrees for every Thread to Steal Work from the others
+    u_int32_t subtreeTarget = threadPool->threadCount() * 8;
+    std::vector<SubtreeRange> level(1);
+    {
+        level[0].begin = 0;
+        level[0].end = photons.size();
+        level[0].nodeIndex = 0;
+    }
+
+    while (level.size() < subtreeTarget && level.size() * 2 <= photons.size())
+    {
+        std::vector<SubtreeRange> nextLevel = std::vector<SubtreeRange>(level.size() * 2);
+        threadPool->ParallelFor(level.size(), [&](u_int32_t i, u_int32_t threadID)
+        {
+            SubtreeRange range = level[i];
+            u_int32_t median = (range.begin < range.end) ? SplitNode(photons, range.begin, range.end, range.nodeIndex) : range.begin;
+
+            SubtreeRange& left = nextLevel[2 * i];
+            SubtreeRange& right = nextLevel[(2 * i) + 1];
+            {
+                left.begin = range.begin;
+                left.end = median;
+                left.nodeIndex = (2 * range.nodeIndex) + 1;
+
+                right.begin = glm::min(median + 1, range.end);
+                right.end = range.end;
+                right.nodeIndex = (2 * range.nodeIndex) + 2;
+            }
+        });
+        level.swap(nextLevel);
+    }
+
+    threadPool->ParallelFor(level.size(), [&](u_int32_t i, u_int32_t threadID)
+    {
+        BuildSubtree(photons, level[i].begin, level[i].end, level[i].nodeIndex);
+    });
+}
+
+void PhotonKdTree::BuildSubtree(std::vector<Photon>& photons, u_int32_t begin, u_int32_t end, u_int32_t nodeIndex)
+{
+    if (begin >= end)
+        return;
+
+    u_int32_t median = SplitNode(photons, begin, end, nodeIndex);
+
+    BuildSubtree(photons, begin, median, (2 * nodeIndex) + 1);
+    BuildSubtree(photons, median + 1, end, (2 * nodeIndex) + 2);
+}
+
+u_int32_t PhotonKdTree::SplitNode(std::vector<Photon>& photons, u_int32_t begin, u_int32_t end, u_int32_t nodeIndex)
+{
+    // Split along the Longest Side of the Subtree's Bounds
+    glm::vec3 lowerBound = photons[begin].position;
+    glm::vec3 upperBound = photons[begin].position;
+    for (u_int32_t i = begin + 1; i < end; i++)
+    {
+        lowerBound = glm::min(lowerBound, photons[i].position);
+        upperBound = glm::max(upperBound, photons[i].position);
+    }
+    glm::vec3 extent = upperBound - lowerBound;
+
+    u_int8_t axis = 0;
+    if (extent.y > extent[axis])
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    // The Median is Chosen so the Heap stays Left-Balanced, and so has no Gaps
+    u_int32_t median = begin + LeftSubtreeSize(end - begin);
+    std::nth_element(photons.begin() + begin, photons.begin() + median, photons.begin() + end,
+        [axis](const Photon& a, const Photon& b) { return a.position[axis] < b.position[axis]; });
+
+    m_builtNodes[nodeIndex] = photons[median];
+    m_builtNodes[nodeIndex].SetSplitAxis(axis);
+
+    return median;
+}
+
+u_int32_t PhotonKdTree::LeftSubtreeSize(u_int32_t photonCount)
+{
+    // Width of the Deepest Complete Level, and how many Nodes Spill into the Incomplete Level below it
+    u_int32_t levelWidth = 1;
+    while ((levelWidth * 4) - 1 <= photonCount)
+        levelWidth *= 2;
+
+    u_int32_t spilledCount = photonCount - ((levelWidth * 2) - 1);
+
+    // The Left Subtree holds Half of every Complete Level, and Fills the Incomplete Level First
+    return (levelWidth - 1) + glm::min(spilledCount, levelWidth);
+}
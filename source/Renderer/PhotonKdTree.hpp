@@ -0,0 +1,150 @@
+#pragma once
+
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Photon.hpp"
+#include "ThreadPool.hpp"
+
+#define MAX_GATHER_PHOTONS 256
+#define MAX_TRAVERSAL_DEPTH 64
+#define PARALLEL_BUILD_THRESHOLD 65536 // Fewer Photons than this are Built on the Calling Thread
+
+struct GatheredPhoton
+{
+    float distanceSquared;
+    const Photon* photon;
+};
+
+// Restricts a Gather to Photons that Reached the Shaded Surface: Arriving on the Side its Normal Faces, and within a Thin Disc about its Tangent Plane
+// Photons behind a Thin Wall or on a Nearby Surface then never Take a Place among the k Nearest
+struct SurfaceFilter
+{
+    SurfaceFilter();
+    SurfaceFilter(glm::vec3 normal, float discThickness);
+
+    glm::vec3 normal;
+    float discThickness; // Furthest a Photon may be from the Tangent Plane
+
+    // How Far the Disc Reaches along each Axis is Radius * axisSpread + axisThickness
+    float axisSpread[3];
+    float axisThickness[3];
+
+    bool Accepts(const Photon& photon, glm::vec3 offset) const
+    {
+        return glm::dot(photon.Direction(), normal) > 0.0f && glm::abs(glm::dot(offset, normal)) <= discThickness;
+    }
+
+    // The Squared Search Radius at which the Disc would First Cross a Split Plane planeDistance away
+    float PlaneDistanceSquared(u_int8_t axis, float planeDistance) const;
+};
+
+// Per-Thread Query Context: the Fixed-Capacity Result Buffer and Traversal Stack of a Nearest-Photon Query
+// Queries keep all their Scratch State here, so any Number of Threads can Query one Tree at once,
+// each with its own PhotonGather, without Locks or Allocation
+// Results are Held as a Bounded Max-Heap: once Full, the Furthest Photon is at the Front and Bounds the Search
+struct PhotonGather
+{
+    PhotonGather();
+
+    u_int32_t maxNumber;
+    u_int32_t count;
+    float maxDistanceSquared;
+
+    GatheredPhoton neighbours[MAX_GATHER_PHOTONS];
+
+    u_int32_t stackSize;
+    std::pair<u_int32_t, float> traversalStack[MAX_TRAVERSAL_DEPTH]; // Deferred Far Children, with the Squared Radius at which the Search Reaches them
+
+    bool filtered;
+    SurfaceFilter filter;
+
+    void Reset(u_int32_t maxNumber, float maxDistance);
+    void Reset(u_int32_t maxNumber, float maxDistance, const SurfaceFilter& filter);
+    void Insert(const Photon* photon, float distanceSquared);
+
+    bool Accepts(const Photon& photon, glm::vec3 offset) const { return !filtered || filter.Accepts(photon, offset); }
+    float PlaneDistanceSquared(u_int8_t axis, float planeDistance) const { return filtered ? filter.PlaneDistanceSquared(axis, planeDistance) : planeDistance * planeDistance; }
+
+    float furthestDistance() const;
+};
+
+// Left-Balanced 3D Kd-Tree Stored as a Flat Heap (Jensen 2001)
+// The Children of Node i are Nodes 2i+1 and 2i+2, so no Child Pointers are Needed,
+// and every Node is the Photon itself, with its Payload and Split Axis Inline
+class PhotonKdTree
+{
+public:
+    PhotonKdTree();
+    // Moves Rebind m_nodes to the Moved Buffer, unless it Points at Attached Nodes Owned Elsewhere
+    PhotonKdTree(PhotonKdTree&& other) noexcept;
+    PhotonKdTree& operator=(PhotonKdTree&& other) noexcept;
+
+private:
+    PhotonKdTree(const PhotonKdTree&);
+    PhotonKdTree& operator=(const PhotonKdTree&);
+
+    std::vector<Photon> m_builtNodes;
+    const Photon* m_nodes; // Either m_builtNodes, or an Attached Array Owned Elsewhere
+    u_int32_t m_nodeCount;
+
+public:
+    size_t size() const { return m_nodeCount; }
+    const Photon* nodes() const { return m_nodes; }
+
+    // Given a ThreadPool, the Top Levels are Split a Level at a time and the Subtrees below them are Built as Tasks
+    void Build(std::vector<Photon> photons, ThreadPool* threadPool = nullptr);
+    // Serves Queries from Nodes a previous Build Laid Out, such as a Mapped Cache File, without Copying them
+    void Attach(const Photon* nodes, u_int32_t nodeCount);
+
+    // Collects up to maxNumber Nearest Photons within maxDistance, Skipping Subtrees beyond the Filter's Disc as well as the Search Sphere
+    void GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter = nullptr) const;
+    // Searches this Tree into a Gather already Reset, Keeping the Photons it Holds, so one Gather can Span Several Trees
+    void SearchNearestPhotons(glm::vec3 point, PhotonGather& gather) const;
+
+    // Calls visitor(photon, distanceSquared) for every Photon within maxDistance, in no Particular Order
+    template<typename Visitor>
+    void VisitPhotonsInRange(glm::vec3 point, float maxDistance, Visitor& visitor) const
+    {
+        if (m_nodeCount > 0)
+            VisitSubtree(0, point, maxDistance * maxDistance, visitor);
+    }
+
+private:
+    struct SubtreeRange
+    {
+        u_int32_t begin;
+        u_int32_t end;
+        u_int32_t nodeIndex;
+    };
+
+    void BuildParallel(std::vector<Photon>& photons, ThreadPool* threadPool);
+    void BuildSubtree(std::vector<Photon>& photons, u_int32_t begin, u_int32_t end, u_int32_t nodeIndex);
+    u_int32_t SplitNode(std::vector<Photon>& photons, u_int32_t begin, u_int32_t end, u_int32_t nodeIndex);
+    static u_int32_t LeftSubtreeSize(u_int32_t photonCount);
+
+    template<typename Visitor>
+    void VisitSubtree(u_int32_t nodeIndex, glm::vec3 point, float maxDistanceSquared, Visitor& visitor) const
+    {
+        const Photon& photon = m_nodes[nodeIndex];
+
+        u_int32_t leftChild = (2 * nodeIndex) + 1;
+        if (leftChild < m_nodeCount)
+        {
+            float planeDistance = point[photon.splitAxis()] - photon.position[photon.splitAxis()];
+            bool crossesPlane = planeDistance * planeDistance < maxDistanceSquared;
+
+            if (planeDistance < 0.0f || crossesPlane)
+                VisitSubtree(leftChild, point, maxDistanceSquared, visitor);
+            if (leftChild + 1 < m_nodeCount && (planeDistance >= 0.0f || crossesPlane))
+                VisitSubtree(leftChild + 1, point, maxDistanceSquared, visitor);
+        }
+
+        glm::vec3 offset = photon.position - point;
+        float distanceSquared = glm::dot(offset, offset);
+        if (distanceSquared <= maxDistanceSquared)
+            visitor(photon, distanceSquared);
+    }
+};
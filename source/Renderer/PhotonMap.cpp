@@ -0,0 +1,437 @@
+#include "PhotonMap.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include <glm/gtc/constants.hpp>
+
+#include "Morton.hpp"
+#include "Sampler.hpp"
+
+// Scratch Space for Irradiance Precomputation, one per Thread Pool Worker
+static thread_local PhotonGather threadIrradianceGather;
+
+struct CandidateCollector
+{
+    std::vector<const Photon*>& candidates;
+
+    void operator()(const Photon& photon, float distanceSquared)
+    {
+        candidates.push_back(&photon);
+    }
+};
+
+struct FacingPowerSum
+{
+    glm::vec3 normal;
+
+    u_int32_t photonCount;
+    glm::vec3 power;
+
+    void operator()(const Photon& photon, float distanceSquared)
+    {
+        float facingRatio = glm::dot(photon.Direction(), normal);
+        if (facingRatio <= 0.0f)
+            return;
+
+        photonCount++;
+        power += photon.Power() * facingRatio;
+    }
+};
+
+PhotonMap::PhotonMap(u_int32_t gatherNumber, float gatherRadius) :
+    m_photons(std::vector<Photon>()), m_photonForest(), m_indexedPhotons(0), m_photonGrid(PhotonHashGrid()), m_photonBVH(), m_photonBuckets(),
+    m_backend(PhotonMapBackend::KdTree), m_irradianceTree(), m_emittedPhotons(0), m_gatherNumber(gatherNumber), m_gatherRadius(gatherRadius) {}
+
+void PhotonMap::Clear()
+{
+    m_photons.clear();
+    m_photonForest.Clear();
+    m_indexedPhotons = 0;
+    m_irradianceTree.Build(std::vector<Photon>());
+    m_emittedPhotons = 0;
+}
+
+void PhotonMap::AddPhotons(const std::vector<Photon>& photons)
+{
+    m_photons.insert(m_photons.end(), photons.begin(), photons.end());
+}
+
+void PhotonMap::Build(RTCDevice device, ThreadPool* threadPool)
+{
+    m_irradianceTree.Build(std::vector<Photon>());
+
+    if (m_backend == PhotonMapBackend::KdTree)
+    {
+        if (m_indexedPhotons < m_photons.size())
+            m_photonForest.Insert(std::vector<Photon>(m_photons.begin() + m_indexedPhotons, m_photons.end()), threadPool);
+        m_indexedPhotons = m_photons.size();
+        return;
+    }
+
+    // The other Backends may Reorder the Photons, so a later Kd-Tree Build Starts the Forest Over
+    m_photonForest.Clear();
+    m_indexedPhotons = 0;
+
+    if (m_backend == PhotonMapBackend::HashGrid)
+        m_photonGrid.Build(m_photons, m_gatherRadius);
+    else if (m_backend == PhotonMapBackend::EmbreeBVH)
+    {
+        // Embree Leaves Index Photons by Position in the Array, so Sorting Puts each Leaf's Photons next to each other
+        SortPhotons();
+        m_photonBVH.Build(device, m_photons);
+    }
+    else
+        m_photonBuckets.Build(m_photons);
+}
+
+void PhotonMap::Load(const Photon* nodes, u_int32_t nodeCount, u_int64_t emittedPhotons, RTCDevice device)
+{
+    Clear();
+    m_emittedPhotons = emittedPhotons;
+    if (m_backend == PhotonMapBackend::KdTree)
+    {
+        m_photonForest.Attach(nodes, nodeCount);
+        return;
+    }
+
+    m_photons.assign(nodes, nodes + nodeCount);
+    Build(device);
+}
+
+const PhotonKdTree& PhotonMap::KdTree(PhotonKdTree& scratchTree) const
+{
+    if (m_backend == PhotonMapBackend::KdTree)
+        return m_photonForest.MergedTree(scratchTree);
+
+    scratchTree.Build(m_photons);
+    return scratchTree;
+}
+
+void PhotonMap::GatherPhotons(glm::vec3 point, glm::vec3 normal, PhotonGather& gather) const
+{
+    SurfaceFilter filter(normal, m_gatherRadius * DISC_THICKNESS_RATIO);
+    GatherNearestPhotons(point, m_gatherNumber, m_gatherRadius, gather, &filter);
+}
+
+void PhotonMap::GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter) const
+{
+    if (m_backend == PhotonMapBackend::HashGrid)
+        m_photonGrid.GatherNearestPhotons(point, maxNumber, maxDistance, gather, filter);
+    else if (m_backend == PhotonMapBackend::EmbreeBVH)
+        m_photonBVH.GatherNearestPhotons(point, maxNumber, maxDistance, gather, filter);
+    else if (m_backend == PhotonMapBackend::BucketTree)
+        m_photonBuckets.GatherNearestPhotons(point, maxNumber, maxDistance, gather, filter);
+    else
+        m_photonForest.GatherNearestPhotons(point, maxNumber, maxDistance, gather, filter);
+}
+
+u_int32_t PhotonMap::GatherFacingPower(glm::vec3 point, float maxDistance, glm::vec3 normal, glm::vec3& power) const
+{
+    u_int32_t photonCount;
+    if (m_backend == PhotonMapBackend::BucketTree)
+        photonCount = m_photonBuckets.GatherFacingPower(point, maxDistance, normal, power);
+    else
+    {
+        FacingPowerSum sum = { normal, 0, glm::vec3(0.0f, 0.0f, 0.0f) };
+        VisitPhotonsInRange(point, maxDistance, sum);
+        power = sum.power;
+        photonCount = sum.photonCount;
+    }
+
+    power *= powerScale();
+    return photonCount;
+}
+
+glm::vec3 PhotonMap::EstimateIrradiance(const PhotonGather& gather, glm::vec3 normal, bool excludeCentre) const
+{
+    float kValue = 0.8f;
+
+    glm::vec3 photonColour(0.0f, 0.0f, 0.0f);
+    if (gather.count == 0)
+        return photonColour;
+
+    // The Gather Radius Bounds the Search, but once Enough Photons are Found their Furthest Sets the Estimate's Area
+    float photonRangeRadius = (gather.count == gather.maxNumber) ? gather.furthestDistance() : m_gatherRadius;
+    for (u_int32_t i = 0; i < gather.count; i++)
+    {
+        if (excludeCentre && gather.neighbours[i].distanceSquared == 0.0f)
+        {
+            excludeCentre = false;
+            continue;
+        }
+
+        float distance = glm::sqrt(gather.neighbours[i].distanceSquared);
+        const Photon* photon = gather.neighbours[i].photon;
+
+        float facingRatio = glm::dot(photon->Direction(), normal);
+        if (facingRatio <= 0.0f)
+            continue;
+
+        float photonWeight = 1 - (distance / (kValue * photonRangeRadius));
+        if (photonWeight < 0.0f)
+            photonWeight = 0.0f;
+
+        photonColour += photon->Power() * (facingRatio * photonWeight);
+    }
+
+    return (photonColour * powerScale()) / ((1.0f - (2.0f / (3 * kValue))) * glm::pi<float>() * glm::pow(photonRangeRadius, 2.0f));
+}
+
+void PhotonMap::PrecomputeIrradiance(ThreadPool* threadPool, u_int32_t stride)
+{
+    // A Map Loaded from a Cache, or Extended since, Holds Photons only in its Forest
+    PhotonKdTree scratchTree;
+    const Photon* photons = m_photons.data();
+    u_int32_t photonCount = m_photons.size();
+    if (m_photons.size() < m_photonForest.size())
+    {
+        const PhotonKdTree& photonTree = m_photonForest.MergedTree(scratchTree);
+        photons = photonTree.nodes();
+        photonCount = photonTree.size();
+    }
+
+    stride = glm::max(stride, 1u);
+    std::vector<Photon> irradiancePhotons = std::vector<Photon>((photonCount + stride - 1) / stride);
+    auto estimateTask = [&](u_int32_t taskID, u_int32_t threadID)
+    {
+        u_int32_t end = glm::min((taskID + 1) * IRRADIANCE_TASK_SIZE, (u_int32_t)irradiancePhotons.size());
+        for (u_int32_t i = taskID * IRRADIANCE_TASK_SIZE; i < end; i++)
+        {
+            const Photon& photon = photons[i * stride];
+            glm::vec3 normal = photon.Normal();
+
+            // One more Photon is Gathered than at a Shading Point, so there are as Many besides the Photon itself
+            PhotonGather& gather = threadIrradianceGather;
+            SurfaceFilter filter(normal, m_gatherRadius * DISC_THICKNESS_RATIO);
+            GatherNearestPhotons(photon.position, glm::min(m_gatherNumber + 1, (u_int32_t)MAX_GATHER_PHOTONS), m_gatherRadius, gather, &filter);
+
+            Photon& irradiancePhoton = irradiancePhotons[i];
+            {
+                irradiancePhoton.position = photon.position;
+                irradiancePhoton.SetPower(EstimateIrradiance(gather, normal, true));
+                irradiancePhoton.SetDirection(normal);
+                irradiancePhoton.flags = 0;
+                irradiancePhoton.SetNormal(normal);
+            }
+        }
+    };
+
+    u_int32_t taskCount = (irradiancePhotons.size() + IRRADIANCE_TASK_SIZE - 1) / IRRADIANCE_TASK_SIZE;
+    if (threadPool != nullptr)
+        threadPool->ParallelFor(taskCount, estimateTask);
+    else
+    {
+        for (u_int32_t taskID = 0; taskID < taskCount; taskID++)
+            estimateTask(taskID, 0);
+    }
+
+    m_irradianceTree.Build(irradiancePhotons, threadPool);
+}
+
+bool PhotonMap::LookupIrradiance(glm::vec3 point, glm::vec3 normal, PhotonGather& gather, glm::vec3& irradiance) const
+{
+    if (m_irradianceTree.size() == 0)
+        return false;
+
+    // An Irradiance Photon's Direction is its Normal, so the Filter Keeps the Fetch to Irradiance on the Same Side of the Same Surface
+    SurfaceFilter filter(normal, m_gatherRadius * DISC_THICKNESS_RATIO);
+    m_irradianceTree.GatherNearestPhotons(point, IRRADIANCE_LOOKUP_NUMBER, m_gatherRadius, gather, &filter);
+
+    // The Filter only Asks that the Normals Face the Same Way, so where Surfaces Meet some may be on the other Surface
+    glm::vec3 irradianceSum(0.0f, 0.0f, 0.0f);
+    u_int32_t irradianceCount = 0;
+    for (u_int32_t i = 0; i < gather.count; i++)
+    {
+        const Photon* irradiancePhoton = gather.neighbours[i].photon;
+        if (glm::dot(irradiancePhoton->Direction(), normal) >= IRRADIANCE_NORMAL_COSINE)
+        {
+            irradianceSum += irradiancePhoton->Power();
+            irradianceCount++;
+        }
+    }
+
+    if (irradianceCount == 0)
+        return false;
+
+    irradiance = irradianceSum / (float)irradianceCount;
+    return true;
+}
+
+void PhotonMap::MeasureQueryThroughput(RTCDevice device, u_int64_t seed, u_int32_t queryCount) const
+{
+    if (m_photons.empty() || queryCount == 0)
+        return;
+
+    PhotonKdTree photonTree;
+    photonTree.Build(m_photons);
+    PhotonHashGrid photonGrid;
+    photonGrid.Build(m_photons, m_gatherRadius);
+    PhotonBVH photonBVH;
+    photonBVH.Build(device, m_photons);
+    PhotonBucketTree photonBuckets;
+    photonBuckets.Build(m_photons);
+
+    // Queries are Centred on Stored Photons, Offset within the Gather Radius, so they Land where Surfaces are Shaded
+    Sampler sampler(seed, SampleSequence::UniformRandom);
+    std::vector<glm::vec3> queryPoints = std::vector<glm::vec3>(queryCount);
+    for (u_int32_t q = 0; q < queryCount; q++)
+    {
+        sampler.StartPhoton(q);
+        u_int32_t photonIndex = glm::min((u_int32_t)(sampler.Get1D() * m_photons.size()), (u_int32_t)m_photons.size() - 1);
+        queryPoints[q] = m_photons[photonIndex].position + (sampler.GetUnitSphere() * (m_gatherRadius * sampler.Get1D()));
+    }
+
+    const char* backendNames[4] = { "Kd-Tree", "Hash Grid", "Embree BVH", "Bucket Tree" };
+    PhotonGather gather;
+    for (int backend = 0; backend < 4; backend++)
+    {
+        u_int64_t gatheredCount = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (u_int32_t q = 0; q < queryCount; q++)
+        {
+            if (backend == 0)
+                photonTree.GatherNearestPhotons(queryPoints[q], m_gatherNumber, m_gatherRadius, gather);
+            else if (backend == 1)
+                photonGrid.GatherNearestPhotons(queryPoints[q], m_gatherNumber, m_gatherRadius, gather);
+            else if (backend == 2)
+                photonBVH.GatherNearestPhotons(queryPoints[q], m_gatherNumber, m_gatherRadius, gather);
+            else
+                photonBuckets.GatherNearestPhotons(queryPoints[q], m_gatherNumber, m_gatherRadius, gather);
+            gatheredCount += gather.count;
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+        std::cout << backendNames[backend] << " Gathers per Second: " << (u_int64_t)(queryCount / glm::max(seconds, 1e-9)) << " (" << gatheredCount << " Photons)" << std::endl;
+    }
+}
+
+void PhotonMap::SortPhotons()
+{
+    if (m_photons.empty())
+        return;
+
+    glm::vec3 lowerBound = m_photons[0].position;
+    glm::vec3 upperBound = m_photons[0].position;
+    for (const Photon& photon : m_photons)
+    {
+        lowerBound = glm::min(lowerBound, photon.position);
+        upperBound = glm::max(upperBound, photon.position);
+    }
+
+    std::vector<std::pair<u_int64_t, u_int32_t>> photonOrder = std::vector<std::pair<u_int64_t, u_int32_t>>(m_photons.size());
+    for (u_int32_t i = 0; i < m_photons.size(); i++)
+        photonOrder[i] = std::make_pair(MortonCode(m_photons[i].position, lowerBound, upperBound), i);
+    std::sort(photonOrder.begin(), photonOrder.end());
+
+    std::vector<Photon> sortedPhotons = std::vector<Photon>(m_photons.size());
+    for (u_int32_t i = 0; i < m_photons.size(); i++)
+        sortedPhotons[i] = m_photons[photonOrder[i].second];
+    m_photons.swap(sortedPhotons);
+}
+
+void PhotonMap::SortBatch(const std::vector<glm::vec3>& points, PhotonGatherBatch& batch) const
+{
+    batch.queryOrder.resize(points.size());
+    batch.clusterExtent = m_gatherRadius;
+    if (points.empty())
+        return;
+
+    glm::vec3 lowerBound = points[0];
+    glm::vec3 upperBound = points[0];
+    for (const glm::vec3& point : points)
+    {
+        lowerBound = glm::min(lowerBound, point);
+        upperBound = glm::max(upperBound, point);
+    }
+
+    for (u_int32_t i = 0; i < points.size(); i++)
+        batch.queryOrder[i] = std::make_pair(MortonCode(points[i], lowerBound, upperBound), i);
+    std::sort(batch.queryOrder.begin(), batch.queryOrder.end());
+}
+
+u_int32_t PhotonMap::GatherClusterCandidates(const std::vector<glm::vec3>& points, const std::vector<glm::vec3>* normals, PhotonGatherBatch& batch, u_int32_t clusterBegin) const
+{
+    // The Cluster Grows along the Curve while its Bounds stay within about one Gather Distance, so Shared Candidates are not much more than each Point's own
+    glm::vec3 lowerBound = points[batch.queryOrder[clusterBegin].second];
+    glm::vec3 upperBound = lowerBound;
+    u_int32_t clusterEnd = clusterBegin + 1;
+    while (clusterEnd < points.size() && clusterEnd - clusterBegin < BATCH_CLUSTER_SIZE)
+    {
+        glm::vec3 point = points[batch.queryOrder[clusterEnd].second];
+        glm::vec3 extent = glm::max(upperBound, point) - glm::min(lowerBound, point);
+        if (glm::length(extent) > batch.clusterExtent)
+            break;
+
+        lowerBound = glm::min(lowerBound, point);
+        upperBound = glm::max(upperBound, point);
+        clusterEnd++;
+    }
+
+    batch.candidates.clear();
+    batch.sharedCandidates = false;
+    if (m_gatherNumber == 0 || clusterEnd - clusterBegin == 1)
+        return clusterEnd;
+
+    // Any Photon within the Gather Radius of a Point in the Cluster is within reach of the Cluster's Centre
+    // If the Centre's own Gather is Full, a Point has about as many Photons within its Furthest Distance plus the Point's Offset, which Bounds the Search Tighter
+    // For an Unfiltered Gather that Bound is Exact; a Filtered one is Checked Point by Point in GatherFromCandidates
+    // The Slack Covers Rounding, so a Photon on the Boundary is not Lost
+    glm::vec3 centre = (lowerBound + upperBound) * 0.5f;
+    float halfExtent = glm::length(upperBound - lowerBound) * 0.5f;
+    float reach = m_gatherRadius + halfExtent;
+
+    if (normals != nullptr)
+        GatherPhotons(centre, (*normals)[batch.queryOrder[clusterBegin].second], batch.gather);
+    else
+        GatherPhotons(centre, batch.gather);
+
+    if (batch.gather.count == batch.gather.maxNumber)
+    {
+        reach = glm::min(reach, batch.gather.furthestDistance() + (2.0f * halfExtent));
+        batch.clusterExtent = batch.gather.furthestDistance();
+    }
+    else
+        batch.clusterExtent = m_gatherRadius;
+    reach *= 1.001f;
+
+    CandidateCollector collector = { batch.candidates };
+    VisitPhotonsInRange(centre, reach, collector);
+    batch.sharedCandidates = batch.candidates.size() <= MAX_BATCH_CANDIDATES;
+    batch.clusterCentre = centre;
+    batch.clusterReach = reach;
+
+    return clusterEnd;
+}
+
+void PhotonMap::GatherFromCandidates(glm::vec3 point, const glm::vec3* normal, PhotonGatherBatch& batch) const
+{
+    PhotonGather& gather = batch.gather;
+    if (batch.sharedCandidates)
+    {
+        if (normal != nullptr)
+            gather.Reset(m_gatherNumber, m_gatherRadius, SurfaceFilter(*normal, m_gatherRadius * DISC_THICKNESS_RATIO));
+        else
+            gather.Reset(m_gatherNumber, m_gatherRadius);
+
+        for (const Photon* photon : batch.candidates)
+        {
+            glm::vec3 offset = photon->position - point;
+            float distanceSquared = glm::dot(offset, offset);
+            if (distanceSquared < gather.maxDistanceSquared && gather.Accepts(*photon, offset))
+                gather.Insert(photon, distanceSquared);
+        }
+
+        // The Candidates Hold every Photon within coveredDistance of the Point, so the Result Stands if the Gather never Looked Further
+        float coveredDistance = batch.clusterReach - glm::length(point - batch.clusterCentre);
+        if (coveredDistance >= m_gatherRadius || (gather.count == gather.maxNumber && gather.maxDistanceSquared <= coveredDistance * coveredDistance))
+            return;
+    }
+
+    if (normal != nullptr)
+        GatherPhotons(point, *normal, gather);
+    else
+        GatherPhotons(point, gather);
+}
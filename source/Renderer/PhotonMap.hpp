@@ -0,0 +1,167 @@
+#pragma once
+
+#include <embree3/rtcore.h>
+
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Photon.hpp"
+#include "PhotonKdTree.hpp"
+#include "PhotonForest.hpp"
+#include "PhotonHashGrid.hpp"
+#include "PhotonBVH.hpp"
+#include "PhotonBucketTree.hpp"
+#include "ThreadPool.hpp"
+
+#define BATCH_CLUSTER_SIZE 8          // Most Points to Share one Candidate Search in a Batched Gather
+#define MAX_BATCH_CANDIDATES 2048     // Clusters with more Candidates than this are Gathered Point by Point
+#define DISC_THICKNESS_RATIO 0.2f     // Half-Thickness of a Surface-Filtered Gather's Disc, as a Fraction of the Gather Radius
+#define IRRADIANCE_PHOTON_STRIDE 4    // One in this many Photons is Given a Precomputed Irradiance
+#define IRRADIANCE_TASK_SIZE 1024     // Irradiance Photons Estimated per Thread Pool Task
+#define IRRADIANCE_LOOKUP_NUMBER 8    // Nearest Irradiance Photons a Lookup Averages
+#define IRRADIANCE_NORMAL_COSINE 0.9f // Least Cosine between a Lookup's Normal and an Irradiance Photon's it will Take
+
+enum class PhotonMapBackend
+{
+    KdTree,   // Forest of Left-Balanced Kd-Trees, for k-Nearest Gathers of any Radius, Extended Photon Batch by Batch
+    HashGrid, // Hashed Uniform Grid, for Gathers within a Fixed Radius
+    EmbreeBVH, // Embree BVH over Photon Points, Traversed by rtcPointQuery
+    BucketTree // Kd-Tree with Buckets of up to 16 Photons per Leaf, Scanned with SIMD, and Subtree Aggregates for Range Gathers
+};
+
+// Scratch State of a Batched Gather, Kept per Thread like PhotonGather, so Batches stop Allocating once Warm
+struct PhotonGatherBatch
+{
+    PhotonGather gather;
+
+    std::vector<std::pair<u_int64_t, u_int32_t>> queryOrder; // Morton Code and Index of every Point, Sorted
+    std::vector<const Photon*> candidates;                  // Every Photon within clusterReach of clusterCentre
+    bool sharedCandidates;                                  // Cleared when the Cluster Overflowed the Candidate Limit
+    glm::vec3 clusterCentre;
+    float clusterReach;
+    float clusterExtent;                                    // Widest a Cluster may Grow, from the Gather Distance of the Cluster before
+};
+
+// Stored Photons, the Lookup Structure Built over them, and the Parameters Gathers from this Map Use
+// Lookups are const and Fill the Calling Thread's own PhotonGather, so Render Threads can Share a Map without Locks
+class PhotonMap
+{
+public:
+    PhotonMap(u_int32_t gatherNumber, float gatherRadius);
+
+private:
+    std::vector<Photon> m_photons;
+
+    PhotonForest m_photonForest;
+    size_t m_indexedPhotons; // How Many of m_photons the Forest Holds; those Added since are Inserted at the next Build
+    PhotonHashGrid m_photonGrid;
+    PhotonBVH m_photonBVH;
+    PhotonBucketTree m_photonBuckets;
+    PhotonMapBackend m_backend;
+
+    // Irradiance Photons (Christensen 1999): Stored as Photons whose Power is the Irradiance and whose Direction is the Surface Normal
+    PhotonKdTree m_irradianceTree;
+
+    u_int64_t m_emittedPhotons; // Photons Emitted into the Map over every Pass, which Stored Power is Divided by when Estimated
+
+    u_int32_t m_gatherNumber;
+    float m_gatherRadius; // Also Sizes the Cells of the Hash Grid, which never Gathers Further than this
+
+public:
+    // A Map Loaded from a Cache into a Kd-Tree Holds those Photons only in the Forest
+    size_t size() const { return glm::max(m_photons.size(), m_photonForest.size()); }
+    const std::vector<Photon>& photons() const { return m_photons; }
+
+    u_int64_t emittedPhotons() const { return m_emittedPhotons; }
+    // Stored Power is the Flux a Photon would Carry were its Pass the only one, so this Turns it into the Flux it Carries among every Pass
+    float powerScale() const { return (m_emittedPhotons > 0) ? 1.0f / (float)m_emittedPhotons : 1.0f; }
+
+    u_int32_t gatherNumber() const { return m_gatherNumber; }
+    float gatherRadius() const { return m_gatherRadius; }
+
+    // Both Take Effect at the next Build
+    void SetBackend(PhotonMapBackend backend) { m_backend = backend; }
+    void SetGatherParameters(u_int32_t gatherNumber, float gatherRadius) { m_gatherNumber = gatherNumber; m_gatherRadius = gatherRadius; }
+
+    void Clear();
+    void AddPhotons(const std::vector<Photon>& photons);
+    // Counts a Pass's Photons, Stored or not, so Passes of any Size can be Added to the Map
+    void AddEmittedPhotons(u_int64_t photonNumber) { m_emittedPhotons += photonNumber; }
+    // The Kd-Tree Backend only Indexes the Photons Added since its last Build; the others are Rebuilt from every Photon
+    // The ThreadPool, if Given, Builds the Kd-Trees in Parallel; the Embree BVH Uses Embree's own Threads
+    void Build(RTCDevice device, ThreadPool* threadPool = nullptr);
+
+    // Takes Kd-Tree Nodes an Earlier Build Laid Out, Attached in Place on the Kd-Tree Backend, and Built from on the Others
+    void Load(const Photon* nodes, u_int32_t nodeCount, u_int64_t emittedPhotons, RTCDevice device);
+    // The Kd-Tree over this Map, Built into scratchTree if the Map Uses another Backend
+    const PhotonKdTree& KdTree(PhotonKdTree& scratchTree) const;
+
+    // Collects up to gatherNumber Nearest Photons within gatherRadius
+    void GatherPhotons(glm::vec3 point, PhotonGather& gather) const { GatherNearestPhotons(point, m_gatherNumber, m_gatherRadius, gather); }
+    // As above, but only Photons Arriving on the Surface with this Normal, within a Disc about its Tangent Plane, Count towards gatherNumber
+    void GatherPhotons(glm::vec3 point, glm::vec3 normal, PhotonGather& gather) const;
+    void GatherNearestPhotons(glm::vec3 point, u_int32_t maxNumber, float maxDistance, PhotonGather& gather, const SurfaceFilter* filter = nullptr) const;
+
+    // Cone-Filtered Estimate of the Flux Arriving per Unit Area from the Gathered Photons
+    // An Estimate Centred on a Photon Excludes it, as a Point Shaded there would Lie among the Photons rather than on one
+    glm::vec3 EstimateIrradiance(const PhotonGather& gather, glm::vec3 normal, bool excludeCentre = false) const;
+
+    // Estimates the Irradiance at every stride-th Photon, on the Surface it was Stored on, once and in Parallel; Discarded at the next Build
+    void PrecomputeIrradiance(ThreadPool* threadPool, u_int32_t stride = IRRADIANCE_PHOTON_STRIDE);
+    bool hasIrradiance() const { return m_irradianceTree.size() > 0; }
+    // Averages the Nearest Precomputed Irradiance on a Surface with this Normal, within the Gather Radius
+    // A Single Nearest Value would Favour Irradiance Photons in Sparse Patches, whose Estimates are Low and whose Neighbourhoods are Large
+    // Returns false if there is None, when the Irradiance has to be Estimated from the Photons
+    bool LookupIrradiance(glm::vec3 point, glm::vec3 normal, PhotonGather& gather, glm::vec3& irradiance) const;
+
+    // Gathers as GatherPhotons does for every Point of a Batch, such as the Shading Points of an Image Tile, Calling callback(pointIndex, gather) for each
+    // Points are Visited in Morton Order, and Runs of Nearby Points Share one Range Search for the Photons any of them can Reach
+    // Given normals, each Point's Gather is Surface-Filtered as by GatherPhotons(point, normal, gather)
+    template<typename Callback>
+    void GatherPhotonsBatch(const std::vector<glm::vec3>& points, PhotonGatherBatch& batch, Callback& callback, const std::vector<glm::vec3>* normals = nullptr) const
+    {
+        SortBatch(points, batch);
+        for (u_int32_t clusterBegin = 0; clusterBegin < points.size();)
+        {
+            u_int32_t clusterEnd = GatherClusterCandidates(points, normals, batch, clusterBegin);
+            for (u_int32_t q = clusterBegin; q < clusterEnd; q++)
+            {
+                u_int32_t pointIndex = batch.queryOrder[q].second;
+                GatherFromCandidates(points[pointIndex], (normals != nullptr) ? &(*normals)[pointIndex] : nullptr, batch);
+                callback(pointIndex, batch.gather);
+            }
+            clusterBegin = clusterEnd;
+        }
+    }
+
+    // Sums the Power, times its Facing Ratio, of every Photon within maxDistance Arriving on a Surface with this Normal, and Returns how Many there were
+    // The Bucket Tree Takes whole Subtrees from their Aggregates; the other Backends Visit each Photon in Range
+    // The Power is Scaled by powerScale(), as the Estimates are
+    u_int32_t GatherFacingPower(glm::vec3 point, float maxDistance, glm::vec3 normal, glm::vec3& power) const;
+
+    // Visited Photons Hold their Stored Power, which powerScale() Turns into Flux
+    template<typename Visitor>
+    void VisitPhotonsInRange(glm::vec3 point, float maxDistance, Visitor& visitor) const
+    {
+        if (m_backend == PhotonMapBackend::HashGrid)
+            m_photonGrid.VisitPhotonsInRange(point, maxDistance, visitor);
+        else if (m_backend == PhotonMapBackend::EmbreeBVH)
+            m_photonBVH.VisitPhotonsInRange(point, maxDistance, visitor);
+        else if (m_backend == PhotonMapBackend::BucketTree)
+            m_photonBuckets.VisitPhotonsInRange(point, maxDistance, visitor);
+        else
+            m_photonForest.VisitPhotonsInRange(point, maxDistance, visitor);
+    }
+
+    // Times Gathers around Stored Photons on every Backend, and Prints Queries per Second
+    void MeasureQueryThroughput(RTCDevice device, u_int64_t seed, u_int32_t queryCount) const;
+
+private:
+    void SortPhotons();
+
+    void SortBatch(const std::vector<glm::vec3>& points, PhotonGatherBatch& batch) const;
+    u_int32_t GatherClusterCandidates(const std::vector<glm::vec3>& points, const std::vector<glm::vec3>* normals, PhotonGatherBatch& batch, u_int32_t clusterBegin) const;
+    void GatherFromCandidates(glm::vec3 point, const glm::vec3* normal, PhotonGatherBatch& batch) const;
+};
@@ -0,0 +1,154 @@
+#include "PhotonMapCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PHOTON_CACHE_MAGIC "PHOTONS"
+#define PHOTON_CACHE_ALIGNMENT 64
+
+static const char alignmentPadding[PHOTON_CACHE_ALIGNMENT] = {};
+
+PhotonMapCache::PhotonMapCache() :
+    m_mapping(nullptr), m_mappingSize(0) {}
+
+PhotonMapCache::~PhotonMapCache()
+{
+    Close();
+}
+
+bool PhotonMapCache::Open(std::string fileName, u_int64_t key)
+{
+    Close();
+
+    int file = open(fileName.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat fileStatus;
+    if (fstat(file, &fileStatus) != 0 || (size_t)fileStatus.st_size < sizeof(FileHeader))
+    {
+        close(file);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    m_mapping = mapping;
+    m_mappingSize = fileStatus.st_size;
+
+    const FileHeader& header = *(const FileHeader*)m_mapping;
+    bool valid = std::memcmp(header.magic, PHOTON_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == PHOTON_CACHE_VERSION && header.photonSize == sizeof(Photon) &&
+        header.key == key && header.treeCount <= MAX_CACHED_TREES &&
+        NodeOffset(header, header.treeCount) <= m_mappingSize;
+
+    if (!valid)
+        Close();
+    return valid;
+}
+
+void PhotonMapCache::Close()
+{
+    if (m_mapping != nullptr)
+        munmap(m_mapping, m_mappingSize);
+
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+}
+
+u_int32_t PhotonMapCache::treeCount() const
+{
+    if (m_mapping == nullptr)
+        return 0;
+
+    return ((const FileHeader*)m_mapping)->treeCount;
+}
+
+const Photon* PhotonMapCache::treeNodes(u_int32_t tree, u_int32_t& nodeCount) const
+{
+    const FileHeader& header = *(const FileHeader*)m_mapping;
+
+    nodeCount = header.nodeCounts[tree];
+    return (const Photon*)((const char*)m_mapping + NodeOffset(header, tree));
+}
+
+u_int64_t PhotonMapCache::emittedPhotons(u_int32_t tree) const
+{
+    return ((const FileHeader*)m_mapping)->emittedPhotons[tree];
+}
+
+bool PhotonMapCache::Write(std::string fileName, u_int64_t key, const std::vector<const PhotonKdTree*>& trees, const std::vector<u_int64_t>& emittedPhotons)
+{
+    if (trees.size() > MAX_CACHED_TREES || emittedPhotons.size() != trees.size())
+        return false;
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    {
+        std::memcpy(header.magic, PHOTON_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PHOTON_CACHE_VERSION;
+        header.photonSize = sizeof(Photon);
+        header.key = key;
+        header.treeCount = trees.size();
+        for (u_int32_t t = 0; t < trees.size(); t++)
+        {
+            header.nodeCounts[t] = trees[t]->size();
+            header.emittedPhotons[t] = emittedPhotons[t];
+        }
+    }
+
+    // Written Aside and Renamed into Place, so a Render never Maps a Half-Written File
+    std::string temporaryName = fileName + ".tmp";
+    FILE* file = fopen(temporaryName.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t offset = sizeof(header);
+    for (u_int32_t t = 0; t < trees.size() && written; t++)
+    {
+        // Padding keeps every Node Array Aligned once Mapped
+        size_t nodeOffset = NodeOffset(header, t);
+        written = fwrite(alignmentPadding, 1, nodeOffset - offset, file) == nodeOffset - offset;
+
+        size_t nodeCount = trees[t]->size();
+        if (written && nodeCount > 0)
+            written = fwrite(trees[t]->nodes(), sizeof(Photon), nodeCount, file) == nodeCount;
+        offset = nodeOffset + (nodeCount * sizeof(Photon));
+    }
+
+    // The File also Ends on an Aligned Boundary, which Open Checks it Reaches
+    if (written)
+    {
+        size_t fileSize = NodeOffset(header, trees.size());
+        written = fwrite(alignmentPadding, 1, fileSize - offset, file) == fileSize - offset;
+    }
+
+    written = (fclose(file) == 0) && written;
+    if (!written || rename(temporaryName.c_str(), fileName.c_str()) != 0)
+    {
+        remove(temporaryName.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t PhotonMapCache::NodeOffset(const FileHeader& header, u_int32_t tree)
+{
+    // Each Node Array Starts on an Aligned Boundary after the Header and the Arrays before it
+    size_t offset = sizeof(FileHeader);
+    for (u_int32_t t = 0; t <= tree; t++)
+    {
+        offset = (offset + PHOTON_CACHE_ALIGNMENT - 1) & ~(size_t)(PHOTON_CACHE_ALIGNMENT - 1);
+        if (t < tree)
+            offset += (size_t)header.nodeCounts[t] * sizeof(Photon);
+    }
+    return offset;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#include "Photon.hpp"
+#include "PhotonKdTree.hpp"
+
+#define PHOTON_CACHE_VERSION 5
+#define MAX_CACHED_TREES 4
+
+// Versioned Binary File of Kd-Tree Node Arrays, Keyed by a Hash of Everything the Photons Depend on
+// The File is Memory-Mapped and the Trees are Attached to it Directly, so a Repeat Render neither Traces nor Builds
+class PhotonMapCache
+{
+public:
+    PhotonMapCache();
+    ~PhotonMapCache();
+
+private:
+    PhotonMapCache(const PhotonMapCache&);
+    PhotonMapCache& operator=(const PhotonMapCache&);
+
+    struct FileHeader
+    {
+        char magic[8];
+        u_int32_t version;
+        u_int32_t photonSize; // Guards against a File Written with a Different Photon Layout
+        u_int64_t key;
+        u_int32_t treeCount;
+        u_int32_t nodeCounts[MAX_CACHED_TREES];
+        u_int64_t emittedPhotons[MAX_CACHED_TREES]; // Photon Power is Stored Unscaled, so the Maps need these to Estimate from it
+    };
+
+    void* m_mapping;
+    size_t m_mappingSize;
+
+public:
+    // Maps the File and Checks it Matches the Key, Closing any File Mapped before
+    bool Open(std::string fileName, u_int64_t key);
+    void Close();
+
+    // Valid until the Cache is Closed
+    u_int32_t treeCount() const;
+    const Photon* treeNodes(u_int32_t tree, u_int32_t& nodeCount) const;
+    u_int64_t emittedPhotons(u_int32_t tree) const;
+
+    static bool Write(std::string fileName, u_int64_t key, const std::vector<const PhotonKdTree*>& trees, const std::vector<u_int64_t>& emittedPhotons);
+
+private:
+    static size_t NodeOffset(const FileHeader& header, u_int32_t tree);
+};
@@ -1,93 +1,307 @@
 #include "PhotonMapper.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <limits>
 #include <iostream>
 
 #include <glm/gtc/constants.hpp>
-#include <glm/gtc/random.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-PhotonMapper::PhotonMapper(std::vector<MeshGeometry*>* meshObjects, bool caustics, int photonNumber, int maxBounces) :
-    m_photonTree(nullptr), m_photons(std::vector<Photon>()), m_meshObjects(meshObjects), m_caustics(caustics), m_photonNumber(photonNumber), m_maxBounces(maxBounces) {}
+#define PHOTON_BATCH_SIZE 1024
 
-void PhotonMapper::GeneratePhotons(PointLight light, RTCScene scene)
+// Russian Roulette: a Photon Survives a Bounce with Probability equal to the Largest Component of the Surface's Reflectance,
+// and Survivors are Scaled by the Reflectance over that Probability, so Photons Keep their Power Rather than Fading
+static bool SurvivesBounce(glm::vec3 reflectance, glm::vec3 photonColour, Sampler& sampler, glm::vec3& bouncePhotonColour)
 {
-    int p = 0;
-    while (p < m_photonNumber)
+    float survivalProbability = glm::min(glm::max(reflectance.r, glm::max(reflectance.g, reflectance.b)), 1.0f);
+    if (survivalProbability <= 0.0f || sampler.Get1D() >= survivalProbability)
+        return false;
+
+    bouncePhotonColour = (photonColour * reflectance) / survivalProbability;
+    return true;
+}
+
+static u_int64_t HashBytes(u_int64_t hash, const void* data, size_t size)
+{
+    // FNV-1a
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
     {
-        glm::vec3 emissionDirection = glm::normalize(glm::sphericalRand(1.0f));
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
 
-        RTCIntersectContext context;
-        rtcInitIntersectContext(&context);
+template<typename T>
+static u_int64_t HashValue(u_int64_t hash, const T& value)
+{
+    return HashBytes(hash, &value, sizeof(T));
+}
 
-        bool result = CastPhotonRay((light.colour * light.intensity) * (1.0f / m_photonNumber), light.position, emissionDirection, scene, context, 0);
-        if (result || !m_caustics)
-            p++;
-        else
-            p++;
+PhotonMapper::PhotonMapper(RTCDevice* device, std::vector<MeshGeometry*>* meshObjects, ThreadPool* threadPool, int causticPhotonNumber, int globalPhotonNumber, int maxBounces) :
+    m_causticMap(100, 0.05f), m_globalMap(50, 0.25f), m_progressiveMap(0, 0.25f), m_device(device), m_meshObjects(meshObjects), m_threadPool(threadPool),
+    m_causticPhotonNumber(causticPhotonNumber), m_globalPhotonNumber(globalPhotonNumber), m_maxBounces(maxBounces),
+    m_randomSeed(0), m_sampleSequence(SampleSequence::ScrambledSobol), m_emittedPhotons(0)
+{
+    m_progressiveMap.SetBackend(PhotonMapBackend::BucketTree);
+}
+
+void PhotonMapper::GeneratePhotons(const std::vector<PointLight>& lights, RTCScene scene)
+{
+    // Each Map gets its own Pass, so the Caustic Map can be Dense without Spending the same Budget on Global Photons
+    TracePhotons(PhotonMapType::Caustic, m_causticPhotonNumber, lights, scene);
+    TracePhotons(PhotonMapType::Global, m_globalPhotonNumber, lights, scene);
+
+    std::cout << m_causticMap.size() << " Caustic Photons, " << m_globalMap.size() << " Global Photons" << std::endl;
+}
+
+void PhotonMapper::BuildPhotonMaps()
+{
+    m_causticMap.Build(*m_device, m_threadPool);
+    m_globalMap.Build(*m_device, m_threadPool);
+}
+
+void PhotonMapper::PrecomputeIrradiance()
+{
+    m_causticMap.PrecomputeIrradiance(m_threadPool);
+    m_globalMap.PrecomputeIrradiance(m_threadPool);
+}
+
+void PhotonMapper::GenerateProgressivePass(const std::vector<PointLight>& lights, RTCScene scene, int photonNumber)
+{
+    m_progressiveMap.Clear();
+    TracePhotons(PhotonMapType::Progressive, photonNumber, lights, scene);
+
+    m_progressiveMap.Build(*m_device, m_threadPool);
+}
+
+bool PhotonMapper::LoadPhotonCache(std::string directory, const std::vector<PointLight>& lights, RTCScene scene)
+{
+    u_int64_t key;
+    std::string fileName = PhotonCacheFile(directory, lights, scene, key);
+    if (!m_photonCache.Open(fileName, key) || m_photonCache.treeCount() != 2)
+        return false;
+
+    u_int32_t nodeCount;
+    const Photon* nodes = m_photonCache.treeNodes(0, nodeCount);
+    m_causticMap.Load(nodes, nodeCount, m_photonCache.emittedPhotons(0), *m_device);
+    nodes = m_photonCache.treeNodes(1, nodeCount);
+    m_globalMap.Load(nodes, nodeCount, m_photonCache.emittedPhotons(1), *m_device);
+
+    std::cout << "Loaded " << m_causticMap.size() << " Caustic Photons, " << m_globalMap.size() << " Global Photons from " << fileName << std::endl;
+    return true;
+}
+
+bool PhotonMapper::SavePhotonCache(std::string directory, const std::vector<PointLight>& lights, RTCScene scene) const
+{
+    u_int64_t key;
+    std::string fileName = PhotonCacheFile(directory, lights, scene, key);
+
+    PhotonKdTree causticTree, globalTree;
+    std::vector<const PhotonKdTree*> trees;
+    trees.push_back(&m_causticMap.KdTree(causticTree));
+    trees.push_back(&m_globalMap.KdTree(globalTree));
+
+    std::vector<u_int64_t> emittedPhotons;
+    emittedPhotons.push_back(m_causticMap.emittedPhotons());
+    emittedPhotons.push_back(m_globalMap.emittedPhotons());
+
+    return PhotonMapCache::Write(fileName, key, trees, emittedPhotons);
+}
+
+std::string PhotonMapper::PhotonCacheFile(std::string directory, const std::vector<PointLight>& lights, RTCScene scene, u_int64_t& key) const
+{
+    u_int64_t hash = 0xCBF29CE484222325ull;
+    hash = HashValue(hash, (u_int32_t)PHOTON_CACHE_VERSION);
+
+    // Photon Parameters, including the Seed, as a Cache from another Seed would not Reproduce the same Image
+    hash = HashValue(hash, m_causticPhotonNumber);
+    hash = HashValue(hash, m_globalPhotonNumber);
+    hash = HashValue(hash, m_maxBounces);
+    hash = HashValue(hash, m_randomSeed);
+    hash = HashValue(hash, m_sampleSequence);
+    hash = HashValue(hash, (u_int32_t)PROJECTION_MAP_ROWS);
+    hash = HashValue(hash, (u_int32_t)PROJECTION_MAP_COLUMNS);
+
+    for (const PointLight& light : lights)
+    {
+        hash = HashValue(hash, light.position);
+        hash = HashValue(hash, light.colour);
+        hash = HashValue(hash, light.intensity);
     }
 
-    Kdtree::KdNodeVector treeNodes;
-    for (Photon p : m_photons)
+    // Geometry as Placed in the Scene, and every Material Property the Photon Tracer Reads
+    for (u_int32_t geomID = 0; geomID < m_meshObjects->size(); geomID++)
     {
-        std::vector<double> photonPosition(3);
-        {
-            photonPosition[0] = p.position.x;
-            photonPosition[1] = p.position.y;
-            photonPosition[2] = p.position.z;
-        }
-        Kdtree::KdNode photonNode(photonPosition);
-        {
-            PhotonData *data = new PhotonData(p.data);
-            photonNode.data = data;
-        }
-        treeNodes.push_back(photonNode);
+        MeshGeometry* mesh = (*m_meshObjects)[geomID];
+        const float* vertices = (const float*)rtcGetGeometryBufferData(rtcGetGeometry(scene, geomID), RTC_BUFFER_TYPE_VERTEX, 0);
+
+        hash = HashValue(hash, (u_int32_t)mesh->vertices().size());
+        hash = HashBytes(hash, vertices, mesh->vertices().size() * 3 * sizeof(float));
+        hash = HashValue(hash, (u_int32_t)mesh->faceVIDs().size());
+        hash = HashBytes(hash, mesh->faceVIDs().data(), mesh->faceVIDs().size() * sizeof(glm::uvec3));
+
+        const MaterialProperties& properties = mesh->properties();
+        hash = HashValue(hash, properties.albedoColour);
+        hash = HashValue(hash, properties.roughness);
+        hash = HashValue(hash, properties.lightReflection);
+        hash = HashValue(hash, properties.glassiness);
+        hash = HashValue(hash, properties.translucency);
+        hash = HashValue(hash, properties.refractiveIndex);
     }
-    std::cout << m_photons.size() << std::endl;
 
-    m_photonTree = new Kdtree::KdTree(&treeNodes);
+    key = hash;
 
+    char keyName[17];
+    snprintf(keyName, sizeof(keyName), "%016llx", (unsigned long long)key);
+    return directory + "/photons_" + keyName + ".bin";
 }
 
-Kdtree::KdNodeVector PhotonMapper::GetClosestPhotons(glm::vec3 hitPoint, float maxDistance, int &numberPhotons)
+const PhotonMap& PhotonMapper::photonMap(PhotonMapType mapType) const
 {
-    Kdtree::KdNodeVector resultPhotons;
-    std::vector<double> point(3);
-    {
-        point[0] = hitPoint.x;
-        point[1] = hitPoint.y;
-        point[2] = hitPoint.z;
-    }
-    m_photonTree->range_nearest_neighbors(point, maxDistance, &resultPhotons);
+    if (mapType == PhotonMapType::Caustic)
+        return m_causticMap;
+    if (mapType == PhotonMapType::Progressive)
+        return m_progressiveMap;
+    return m_globalMap;
+}
 
-    numberPhotons = resultPhotons.size();
-    return resultPhotons;
+PhotonMap& PhotonMapper::PhotonMapForType(PhotonMapType mapType)
+{
+    if (mapType == PhotonMapType::Caustic)
+        return m_causticMap;
+    if (mapType == PhotonMapType::Progressive)
+        return m_progressiveMap;
+    return m_globalMap;
 }
 
-Kdtree::KdNodeVector PhotonMapper::GetClosestPhotons(glm::vec3 hitPoint, int maxNumber, float &photonDistance)
+void PhotonMapper::GetClosestPhotons(PhotonMapType mapType, glm::vec3 hitPoint, float maxDistance, int maxNumber, PhotonGather& photons, int &numberPhotons) const
 {
-    Kdtree::KdNodeVector resultPhotons;
-    std::vector<double> point(3);
+    photonMap(mapType).GatherNearestPhotons(hitPoint, maxNumber, maxDistance, photons);
+    numberPhotons = photons.count;
+}
+
+void PhotonMapper::GetClosestPhotons(PhotonMapType mapType, glm::vec3 hitPoint, int maxNumber, PhotonGather& photons, float &photonDistance) const
+{
+    // Unbounded on the Kd-Tree and BVH, but Limited to the Gather Radius on the Hash Grid
+    photonMap(mapType).GatherNearestPhotons(hitPoint, maxNumber, std::numeric_limits<float>().infinity(), photons);
+    photonDistance = photons.furthestDistance();
+}
+
+void PhotonMapper::TracePhotons(PhotonMapType mapType, int photonNumber, const std::vector<PointLight>& lights, RTCScene scene)
+{
+    // Caustic Photons are only Emitted towards Specular Objects, so a Light's Share of them Counts only the Power it Sends that Way
+    std::vector<ProjectionMap> projectionMaps = std::vector<ProjectionMap>(lights.size());
+    std::vector<float> emittedFractions = std::vector<float>(lights.size(), 1.0f);
+    std::vector<double> lightWeights = std::vector<double>(lights.size());
+    double totalWeight = 0.0;
+    for (u_int32_t l = 0; l < lights.size(); l++)
     {
-        point[0] = hitPoint.x;
-        point[1] = hitPoint.y;
-        point[2] = hitPoint.z;
+        if (mapType == PhotonMapType::Caustic)
+        {
+            BuildCausticProjection(lights[l], scene, projectionMaps[l]);
+            emittedFractions[l] = projectionMaps[l].empty() ? 0.0f : projectionMaps[l].coverage();
+        }
+
+        glm::vec3 power = lights[l].colour * lights[l].intensity;
+        lightWeights[l] = ((power.r + power.g + power.b) / 3.0f) * emittedFractions[l];
+        totalWeight += lightWeights[l];
     }
-    m_photonTree->k_nearest_neighbors(point, maxNumber, &resultPhotons);
+    if (totalWeight <= 0.0 || photonNumber <= 0)
+        return;
+
+    // The Budget is Split in Proportion to Power, so every Photon Carries about the same Flux whichever Light Emitted it
+    // Photons [lightOffsets[l], lightOffsets[l + 1]) come from Light l
+    std::vector<u_int32_t> lightOffsets = std::vector<u_int32_t>(lights.size() + 1, 0);
+    double cumulativeWeight = 0.0;
+    for (u_int32_t l = 0; l < lights.size(); l++)
+    {
+        cumulativeWeight += lightWeights[l];
+        lightOffsets[l + 1] = (u_int32_t)((photonNumber * (cumulativeWeight / totalWeight)) + 0.5);
+    }
+    u_int32_t totalPhotons = lightOffsets[lights.size()];
+
+    // Photons Store the Flux they would Carry were this Pass the only one, and the Map Divides by every Photon Emitted into it,
+    // so a Map Built from several Passes Estimates the same Light as one Built from a single Pass of them all
+    std::vector<glm::vec3> photonPowers = std::vector<glm::vec3>(lights.size());
+    for (u_int32_t l = 0; l < lights.size(); l++)
+    {
+        u_int32_t lightPhotons = lightOffsets[l + 1] - lightOffsets[l];
+        if (lightPhotons > 0)
+            photonPowers[l] = (lights[l].colour * lights[l].intensity) * (emittedFractions[l] * ((float)totalPhotons / lightPhotons));
+    }
+
+    // Photons are Traced in Batches, each Writing to its own Buffer, so Workers never Contend
+    // Merging the Buffers in Batch Order keeps the Photon Map Independent of Scheduling
+    u_int32_t batchCount = (totalPhotons + PHOTON_BATCH_SIZE - 1) / PHOTON_BATCH_SIZE;
+    std::vector<std::vector<Photon>> batchPhotons = std::vector<std::vector<Photon>>(batchCount);
+
+    u_int64_t firstPhoton = m_emittedPhotons;
+    m_threadPool->ParallelFor(batchCount, [&](u_int32_t batchID, u_int32_t threadID)
+    {
+        RTCIntersectContext context;
+        rtcInitIntersectContext(&context);
+        Sampler sampler(m_randomSeed, m_sampleSequence);
+
+        u_int32_t batchStart = batchID * PHOTON_BATCH_SIZE;
+        u_int32_t batchEnd = glm::min(batchStart + PHOTON_BATCH_SIZE, totalPhotons);
+        u_int32_t light = (std::upper_bound(lightOffsets.begin(), lightOffsets.end(), batchStart) - lightOffsets.begin()) - 1;
+        for (u_int32_t p = batchStart; p < batchEnd; p++)
+        {
+            while (p >= lightOffsets[light + 1])
+                light++;
+
+            sampler.StartPhoton(firstPhoton + p);
+            glm::vec3 emissionDirection = (mapType == PhotonMapType::Caustic) ? projectionMaps[light].SampleDirection(sampler.Get2D()) : sampler.GetUnitSphere();
+
+            CastPhotonRay(mapType, PhotonPath::Emitted, photonPowers[light], lights[light].position, emissionDirection, scene, context, sampler, batchPhotons[batchID], 0);
+        }
+    });
+    m_emittedPhotons += totalPhotons;
+
+    PhotonMap& photonMap = PhotonMapForType(mapType);
+    for (std::vector<Photon>& photons : batchPhotons)
+        photonMap.AddPhotons(photons);
+    photonMap.AddEmittedPhotons(totalPhotons);
+}
 
-    auto furthestPhoton = resultPhotons.at(resultPhotons.size() - 1);
-    glm::vec3 furthestPoint;
+void PhotonMapper::BuildCausticProjection(PointLight light, RTCScene scene, ProjectionMap& projectionMap)
+{
+    // Bounding Spheres of the Glass Meshes, Read from the Scene's Vertex Buffers as those are already Placed in the World
+    std::vector<ProjectionTarget> targets;
+    for (u_int32_t geomID = 0; geomID < m_meshObjects->size(); geomID++)
     {
-        furthestPoint.x = furthestPhoton.point[0];
-        furthestPoint.y = furthestPhoton.point[1];
-        furthestPoint.z = furthestPhoton.point[2];
+        MeshGeometry* mesh = (*m_meshObjects)[geomID];
+        if (mesh->properties().glassiness <= 0.0f || mesh->vertices().empty())
+            continue;
+
+        const float* vertices = (const float*)rtcGetGeometryBufferData(rtcGetGeometry(scene, geomID), RTC_BUFFER_TYPE_VERTEX, 0);
+        glm::vec3 lowerBound(vertices[0], vertices[1], vertices[2]);
+        glm::vec3 upperBound = lowerBound;
+        for (u_int32_t i = 1; i < mesh->vertices().size(); i++)
+        {
+            glm::vec3 vertex(vertices[i*3 + 0], vertices[i*3 + 1], vertices[i*3 + 2]);
+            lowerBound = glm::min(lowerBound, vertex);
+            upperBound = glm::max(upperBound, vertex);
+        }
+
+        ProjectionTarget target;
+        {
+            target.centre = (lowerBound + upperBound) * 0.5f;
+            target.radius = glm::length(upperBound - lowerBound) * 0.5f;
+        }
+        targets.push_back(target);
     }
-    photonDistance = glm::distance(hitPoint, furthestPoint);
-    return resultPhotons;
+
+    if (!targets.empty())
+        projectionMap.Build(light.position, targets);
 }
 
-bool PhotonMapper::CastPhotonRay(glm::vec3 photonColour, glm::vec3 photonOrigin, glm::vec3 photonDirection, RTCScene scene, RTCIntersectContext& context, int rayDepth)
+bool PhotonMapper::CastPhotonRay(PhotonMapType mapType, PhotonPath path, glm::vec3 photonColour, glm::vec3 photonOrigin, glm::vec3 photonDirection, RTCScene scene, RTCIntersectContext& context, Sampler& sampler, std::vector<Photon>& photons, int rayDepth)
 {
     RTCRayHit rayhit;
     {
@@ -133,7 +347,7 @@ bool PhotonMapper::CastPhotonRay(glm::vec3 photonColour, glm::vec3 photonOrigin,
         glm::vec3 reflectionDirection = photonDirection - (2 * glm::dot(glm::normalize(photonDirection), glm::normalize(surfaceNormal)) * glm::normalize(surfaceNormal));
         glm::vec3 incidentDirection = glm::vec3(0.0f, 0.0f, 0.0f);
         {
-            glm::vec3 randomDirection = glm::normalize(glm::sphericalRand(1.0f));
+            glm::vec3 randomDirection = sampler.GetUnitSphere();
             if (randomDirection == -glm::normalize(surfaceNormal) || glm::dot(randomDirection, glm::normalize(surfaceNormal)) < 0.0f)
                 randomDirection = -randomDirection;
                 //randomDirection = -randomDirection; // Somehow surface Normal is Inverted?
@@ -146,50 +360,43 @@ bool PhotonMapper::CastPhotonRay(glm::vec3 photonColour, glm::vec3 photonOrigin,
             incidentDirection = reflectionDirection - (2 * glm::dot(glm::normalize(reflectionDirection), glm::normalize(-surfaceNormal)) * (-surfaceNormal));
         }
 
-        double randChoice = glm::linearRand(0.0f, 1.0f);
+        double randChoice = sampler.Get1D();
         if ((randChoice > surfaceProperties.glassiness && rayDepth > 0) || surfaceProperties.glassiness == 0.0f || rayDepth == m_maxBounces)
         {
-            // Store Photon as Diffuse
-            Photon photon;
+            // Store Photon as Diffuse, in the Caustic Map only if every Bounce before this was Specular
+            if (mapType == PhotonMapType::Progressive || (path == PhotonPath::Specular) == (mapType == PhotonMapType::Caustic))
             {
-                photon.data.colour = photonColour;
-                photon.data.direction = reflectionDirection;
-                photon.position = hitPoint;
-            }
-            m_photons.push_back(photon);
-
-            if (rayDepth < m_maxBounces)
-            {
-                //std::cout << "Called Here" << std::endl;
-                glm::vec3 bouncePhotonColour;
+                Photon photon;
                 {
-                    bouncePhotonColour.r = (photonColour.r * surfaceProperties.albedoColour.r) / glm::pi<float>();
-                    bouncePhotonColour.g = (photonColour.g * surfaceProperties.albedoColour.g) / glm::pi<float>();
-                    bouncePhotonColour.b = (photonColour.b * surfaceProperties.albedoColour.b) / glm::pi<float>();
-
-                    // bouncePhotonColour.r = (photonColour.r * surfaceProperties.albedoColour.r);
-                    // bouncePhotonColour.g = (photonColour.g * surfaceProperties.albedoColour.g);
-                    // bouncePhotonColour.b = (photonColour.b * surfaceProperties.albedoColour.b);
-
-                    bouncePhotonColour *= surfaceProperties.lightReflection;
+                    photon.position = hitPoint;
+                    photon.SetPower(photonColour);
+                    photon.SetDirection(reflectionDirection);
+                    photon.flags = 0;
+                    photon.SetNormal(glm::dot(surfaceNormal, reflectionDirection) < 0.0f ? -surfaceNormal : surfaceNormal);
                 }
+                photons.push_back(photon);
+            }
 
-                CastPhotonRay(bouncePhotonColour, hitPoint, reflectionDirection, scene, context, rayDepth + 1);
+            // No Caustic Path Continues past a Diffuse Bounce
+            glm::vec3 bouncePhotonColour;
+            glm::vec3 diffuseReflectance = (surfaceProperties.albedoColour * surfaceProperties.lightReflection) / glm::pi<float>();
+            if (mapType != PhotonMapType::Caustic && rayDepth < m_maxBounces && SurvivesBounce(diffuseReflectance, photonColour, sampler, bouncePhotonColour))
+            {
+                CastPhotonRay(mapType, PhotonPath::Diffuse, bouncePhotonColour, hitPoint, reflectionDirection, scene, context, sampler, photons, rayDepth + 1);
             }
         }
         else
         {
+            PhotonPath specularPath = (path == PhotonPath::Diffuse) ? PhotonPath::Diffuse : PhotonPath::Specular;
+
             glm::vec3 bouncePhotonColour;
-            {
-                bouncePhotonColour.r = photonColour.r * surfaceProperties.albedoColour.r;
-                bouncePhotonColour.g = photonColour.g * surfaceProperties.albedoColour.g;
-                bouncePhotonColour.b = photonColour.b * surfaceProperties.albedoColour.b;
-            }
-            
-            double randChoice2 = glm::linearRand(0.0f, 1.0f);
+            if (!SurvivesBounce(surfaceProperties.albedoColour, photonColour, sampler, bouncePhotonColour))
+                return true;
+
+            double randChoice2 = sampler.Get1D();
             if (randChoice2 > surfaceProperties.translucency || surfaceProperties.translucency == 0.0f)
             {
-                CastPhotonRay(bouncePhotonColour, hitPoint, reflectionDirection, scene, context, rayDepth + 1);
+                CastPhotonRay(mapType, specularPath, bouncePhotonColour, hitPoint, reflectionDirection, scene, context, sampler, photons, rayDepth + 1);
             }
             else
             {
@@ -242,7 +449,7 @@ bool PhotonMapper::CastPhotonRay(glm::vec3 photonColour, glm::vec3 photonOrigin,
                         glm::vec3 exitPerpendicular = glm::cross(glm::normalize(exitNormal), glm::normalize(refractionDirection));
                         glm::vec3 exitDirection = glm::normalize(exitNormal) * glm::angleAxis(glm::asin(-exitAngleSin), glm::normalize(exitPerpendicular)); // Why the Refraction Angle has to be Negated is Unclear
 
-                        CastPhotonRay(bouncePhotonColour, newHitPoint, exitDirection, scene, context, rayDepth + internalReflections);
+                        CastPhotonRay(mapType, specularPath, bouncePhotonColour, newHitPoint, exitDirection, scene, context, sampler, photons, rayDepth + internalReflections);
                         break;
                     }
                     else if (internalReflections + rayDepth < m_maxBounces)
@@ -1,48 +1,95 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <string>
 #include <vector>
 #include <embree3/rtcore.h>
-#include "../../cdalitz-kdtree-cpp/kdtree.hpp"
 
 #include "../IOManagers/MeshGeometry.hpp"
 #include "PointLight.hpp"
+#include "Photon.hpp"
+#include "PhotonMap.hpp"
+#include "PhotonMapCache.hpp"
+#include "ProjectionMap.hpp"
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
 
-struct PhotonData
+enum class PhotonMapType
 {
-    glm::vec3 direction;
-    glm::vec3 colour;
-};
-
-struct Photon
-{
-    glm::vec3 position;
-    PhotonData data;
+    Caustic, // Light-Specular-Diffuse Paths, Dense and Gathered over a Small Radius
+    Global,     // Every other Diffuse Hit, Sparser and Gathered over a Larger Radius
+    Progressive // Every Diffuse Hit, Kept only for one Pass of Progressive Rendering
 };
 
 class PhotonMapper
 {
 public:
-    PhotonMapper(std::vector<MeshGeometry*>* meshObjects, bool caustics, int photonNumber, int maxBounces);
+    PhotonMapper(RTCDevice* device, std::vector<MeshGeometry*>* meshObjects, ThreadPool* threadPool, int causticPhotonNumber, int globalPhotonNumber, int maxBounces);
 
 private:
-    Kdtree::KdTree* m_photonTree;
-    std::vector<Photon> m_photons;
+    // How a Photon's Path has Bounced so far, which Decides the Map it is Stored in
+    enum class PhotonPath
+    {
+        Emitted,  // Not yet Bounced
+        Specular, // Only Specular Bounces
+        Diffuse   // At least one Diffuse Bounce
+    };
+
+    PhotonMap m_causticMap;
+    PhotonMap m_globalMap;
+    PhotonMap m_progressiveMap;
 
+    PhotonMapCache m_photonCache; // Backs the Maps after a Cache is Loaded
+
+    RTCDevice* m_device;
     std::vector<MeshGeometry*>* m_meshObjects;
+    ThreadPool* m_threadPool;
 
-    bool m_caustics;
-    int m_photonNumber;
+    int m_causticPhotonNumber; // Photons Emitted for each Map, Shared between the Lights by Power
+    int m_globalPhotonNumber;
     int m_maxBounces;
 
+    u_int64_t m_randomSeed;
+    SampleSequence m_sampleSequence;
+    u_int64_t m_emittedPhotons; // Photon Streams Continue across Lights and Maps, so no two Passes Share Random Numbers
+
 public:
-    const Kdtree::KdTree& photons() { return *m_photonTree; };
-    //const std::vector<Photon>& photons() { return m_photons; };
+    const PhotonMap& photonMap(PhotonMapType mapType) const;
+
+    void SetRandomSeed(u_int64_t seed) { m_randomSeed = seed; }
+    void SetSampleSequence(SampleSequence sequence) { m_sampleSequence = sequence; }
+    // The Progressive Map Defaults to the Bucket Tree, as it is only Searched by Range and never Cached
+    void SetBackend(PhotonMapBackend backend) { m_causticMap.SetBackend(backend); m_globalMap.SetBackend(backend); m_progressiveMap.SetBackend(backend); }
+    void SetGatherParameters(PhotonMapType mapType, u_int32_t gatherNumber, float gatherRadius) { PhotonMapForType(mapType).SetGatherParameters(gatherNumber, gatherRadius); }
 
-    void GeneratePhotons(PointLight light, RTCScene scene);
-    Kdtree::KdNodeVector GetClosestPhotons(glm::vec3 hitPoint, float maxDistance, int &numberPhotons);
-    Kdtree::KdNodeVector GetClosestPhotons(glm::vec3 hitPoint, int maxNumber, float &photonDistance);
+    // Emits from every Light in one Pass, Added to any Passes before; the Maps are not Searchable until BuildPhotonMaps
+    void GeneratePhotons(const std::vector<PointLight>& lights, RTCScene scene);
+    // Kd-Tree Maps only Index the Photons Generated since the last Build, so Photons can be Added a Pass at a time
+    void BuildPhotonMaps();
+    // Precomputes Irradiance on the Caustic and Global Maps, once they are Built or Loaded
+    void PrecomputeIrradiance();
+    // Caches Live in directory, in Files Named by a Hash of the Scene, the Lights and every Parameter the Photons Depend on
+    bool LoadPhotonCache(std::string directory, const std::vector<PointLight>& lights, RTCScene scene);
+    bool SavePhotonCache(std::string directory, const std::vector<PointLight>& lights, RTCScene scene) const;
+
+    // Replaces the Progressive Map with photonNumber New Photons Shared between the Lights, so its Memory does not Grow from Pass to Pass
+    void GenerateProgressivePass(const std::vector<PointLight>& lights, RTCScene scene, int photonNumber);
+    void GetClosestPhotons(PhotonMapType mapType, glm::vec3 hitPoint, float maxDistance, int maxNumber, PhotonGather& photons, int &numberPhotons) const;
+    void GetClosestPhotons(PhotonMapType mapType, glm::vec3 hitPoint, int maxNumber, PhotonGather& photons, float &photonDistance) const;
+
+    u_int32_t GatherFacingPower(PhotonMapType mapType, glm::vec3 hitPoint, float maxDistance, glm::vec3 normal, glm::vec3& power) const { return photonMap(mapType).GatherFacingPower(hitPoint, maxDistance, normal, power); }
+
+    template<typename Visitor>
+    void VisitPhotonsInRange(PhotonMapType mapType, glm::vec3 hitPoint, float maxDistance, Visitor& visitor) const { photonMap(mapType).VisitPhotonsInRange(hitPoint, maxDistance, visitor); }
+
+    void MeasureQueryThroughput(PhotonMapType mapType, u_int32_t queryCount) const { photonMap(mapType).MeasureQueryThroughput(*m_device, m_randomSeed, queryCount); }
 
 private:
-    bool CastPhotonRay(glm::vec3 photonColour, glm::vec3 photonOrigin, glm::vec3 photonDirection, RTCScene scene, RTCIntersectContext& context, int rayDepth);
+    PhotonMap& PhotonMapForType(PhotonMapType mapType);
+
+    std::string PhotonCacheFile(std::string directory, const std::vector<PointLight>& lights, RTCScene scene, u_int64_t& key) const;
+
+    void TracePhotons(PhotonMapType mapType, int photonNumber, const std::vector<PointLight>& lights, RTCScene scene);
+    void BuildCausticProjection(PointLight light, RTCScene scene, ProjectionMap& projectionMap);
+    bool CastPhotonRay(PhotonMapType mapType, PhotonPath path, glm::vec3 photonColour, glm::vec3 photonOrigin, glm::vec3 photonDirection, RTCScene scene, RTCIntersectContext& context, Sampler& sampler, std::vector<Photon>& photons, int rayDepth);
 };
\ No newline at end of file
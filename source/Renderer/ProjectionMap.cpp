@@ -0,0 +1,80 @@
+#include "ProjectionMap.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+ProjectionMap::ProjectionMap() :
+    m_markedCells(std::vector<u_int32_t>()) {}
+
+void ProjectionMap::Build(glm::vec3 lightPosition, const std::vector<ProjectionTarget>& targets)
+{
+    m_markedCells.clear();
+
+    // Each Target is Seen from the Light as a Cone of Directions
+    std::vector<glm::vec3> coneAxes;
+    std::vector<float> coneAngles;
+    for (const ProjectionTarget& target : targets)
+    {
+        glm::vec3 offset = target.centre - lightPosition;
+        float distance = glm::length(offset);
+        if (distance <= target.radius)
+        {
+            // The Light is Inside the Bounds, so every Direction can Reach the Target
+            for (u_int32_t cell = 0; cell < PROJECTION_MAP_ROWS * PROJECTION_MAP_COLUMNS; cell++)
+                m_markedCells.push_back(cell);
+            return;
+        }
+
+        coneAxes.push_back(offset / distance);
+        coneAngles.push_back(glm::asin(target.radius / distance));
+    }
+
+    for (u_int32_t row = 0; row < PROJECTION_MAP_ROWS; row++)
+    {
+        for (u_int32_t column = 0; column < PROJECTION_MAP_COLUMNS; column++)
+        {
+            // The Cell's Angular Radius is Bounded by its Corners and Edge Midpoints, with a Margin for the Arcs between them
+            glm::vec3 cellCentre = GridDirection(row + 0.5f, column + 0.5f);
+            float cellAngle = 0.0f;
+            for (u_int32_t i = 0; i < 3; i++)
+            {
+                for (u_int32_t j = 0; j < 3; j++)
+                {
+                    glm::vec3 boundary = GridDirection(row + (0.5f * i), column + (0.5f * j));
+                    cellAngle = glm::max(cellAngle, glm::acos(glm::clamp(glm::dot(cellCentre, boundary), -1.0f, 1.0f)));
+                }
+            }
+            cellAngle *= 1.05f;
+
+            for (u_int32_t t = 0; t < coneAxes.size(); t++)
+            {
+                float angle = glm::acos(glm::clamp(glm::dot(cellCentre, coneAxes[t]), -1.0f, 1.0f));
+                if (angle <= coneAngles[t] + cellAngle)
+                {
+                    m_markedCells.push_back((row * PROJECTION_MAP_COLUMNS) + column);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+glm::vec3 ProjectionMap::SampleDirection(glm::vec2 u) const
+{
+    // The First Dimension Picks the Cell, and what is Left of it Positions the Sample within the Cell
+    float scaledSample = u.x * m_markedCells.size();
+    u_int32_t markedIndex = glm::min((u_int32_t)scaledSample, (u_int32_t)m_markedCells.size() - 1);
+    float cellOffset = glm::min(scaledSample - markedIndex, 1.0f);
+
+    u_int32_t cell = m_markedCells[markedIndex];
+    return GridDirection((cell / PROJECTION_MAP_COLUMNS) + cellOffset, (cell % PROJECTION_MAP_COLUMNS) + u.y);
+}
+
+glm::vec3 ProjectionMap::GridDirection(float row, float column)
+{
+    // Same Equal-Area Mapping as Sampler::GetUnitSphere
+    float z = 1.0f - (2.0f * (row / PROJECTION_MAP_ROWS));
+    float r = glm::sqrt(glm::max(0.0f, 1.0f - (z * z)));
+    float phi = glm::two_pi<float>() * (column / PROJECTION_MAP_COLUMNS);
+
+    return glm::vec3(r * glm::cos(phi), r * glm::sin(phi), z);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <sys/types.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define PROJECTION_MAP_ROWS 64
+#define PROJECTION_MAP_COLUMNS 128
+
+struct ProjectionTarget
+{
+    glm::vec3 centre;
+    float radius;
+};
+
+// Coarse Grid over the Directions around a Light, Marking the Cells that can Reach a Target's Bounding Sphere (Jensen 1996)
+// Cells are Uniform in z and phi, so Equal-Area, and Emitting Uniformly over the Marked Cells is Uniform over the Directions they Cover
+class ProjectionMap
+{
+public:
+    ProjectionMap();
+
+private:
+    std::vector<u_int32_t> m_markedCells;
+
+public:
+    bool empty() const { return m_markedCells.empty(); }
+    // Fraction of all Directions the Marked Cells Cover, which Scales the Power of each Photon Emitted into them
+    float coverage() const { return (float)m_markedCells.size() / (PROJECTION_MAP_ROWS * PROJECTION_MAP_COLUMNS); }
+
+    void Build(glm::vec3 lightPosition, const std::vector<ProjectionTarget>& targets);
+
+    // Maps a Uniform 2D Sample to a Direction within the Marked Cells, Keeping the Sample's Stratification
+    glm::vec3 SampleDirection(glm::vec2 u) const;
+
+private:
+    static glm::vec3 GridDirection(float row, float column);
+};
@@ -5,19 +5,53 @@
 #include <iostream>
 #include <limits>
 #include <chrono>
-#include "../../cdalitz-kdtree-cpp/kdtree.hpp"
 
 #include <glm/gtc/constants.hpp>
-#include <glm/gtc/random.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#define TILE_SIZE 16
+
+// Primary Rays are Traced as 4x2 Pixel Packets
+#define PACKET_WIDTH 4
+#define PACKET_HEIGHT 2
+#define PACKET_SIZE (PACKET_WIDTH * PACKET_HEIGHT)
+
+// Fraction of each Pass's Photons Kept in a Pixel's Count, which Sets how Quickly Radii Shrink
+#define PROGRESSIVE_ALPHA 0.7f
+
+// Scratch Space for Photon Lookups, one per Render Thread, so the Shared Photon Map is Queried without Locks
+static thread_local PhotonGather threadPhotonGather;
+static thread_local PhotonGatherBatch threadPhotonGatherBatch;
+
+// Diffuse Hit of a Wavefront Bounce whose Photon Estimate is Deferred to the Tile's Batched Gather
+struct PhotonShadingPoint
+{
+    u_int32_t pixelIndex;
+    glm::vec3 normal;
+    glm::vec3 weight; // Throughput of the Path into the Hit, times Albedo over Pi
+};
+
+// Adds each Shading Point's Estimate to its Pixel as the Batched Gather Reaches it
+struct TilePhotonEstimate
+{
+    const std::vector<PhotonShadingPoint>& shadingPoints;
+    std::vector<glm::vec3>& tileColours;
+    const PhotonMap& photonMap;
+
+    void operator()(u_int32_t pointIndex, const PhotonGather& gather)
+    {
+        const PhotonShadingPoint& shadingPoint = shadingPoints[pointIndex];
+        tileColours[shadingPoint.pixelIndex] += shadingPoint.weight * photonMap.EstimateIrradiance(gather, shadingPoint.normal);
+    }
+};
+
 Camera::Camera(glm::vec3 position, float fov, float np, float fp) :
         position(position), fieldOfView(fov), nearPlane(np), farPlane(fp) {}
 
-glm::vec3 Camera::getPixelRayDirection(int x, int y, u_int16_t imgWidth, u_int16_t imgHeight)
+glm::vec3 Camera::getPixelRayDirection(int x, int y, u_int16_t imgWidth, u_int16_t imgHeight, glm::vec2 pixelOffset)
 {
-    float xndc = (x + glm::linearRand(0.0f, 1.0f)) / imgWidth;
-    float yndc = (y + glm::linearRand(0.0f, 1.0f)) / imgHeight;
+    float xndc = (x + pixelOffset.x) / imgWidth;
+    float yndc = (y + pixelOffset.y) / imgHeight;
 
     float xscreen = (xndc * 2) - 1;
     float yscreen = 1 - (yndc * 2);
@@ -31,16 +65,52 @@ glm::vec3 Camera::getPixelRayDirection(int x, int y, u_int16_t imgWidth, u_int16
     return glm::normalize(rayDirection);
 }
 
-RenderManager::RenderManager(RTCDevice* device, Camera camera, bool smoothShading, u_int32_t multisamplingIterations, u_int16_t maxRayDepth) :
-    m_device(device), m_scene(nullptr), m_photonMapper(nullptr),
+WavefrontPath::WavefrontPath(u_int32_t pixelIndex, Sampler sampler) :
+    pixelIndex(pixelIndex), throughput(glm::vec3(1.0f, 1.0f, 1.0f)), sampler(sampler), rayDepth(0),
+    refractiveIndex(0.0f), internalReflections(0) {}
+
+VisiblePoint::VisiblePoint() :
+    valid(false), position(glm::vec3(0.0f, 0.0f, 0.0f)), normal(glm::vec3(0.0f, 0.0f, 0.0f)), weight(glm::vec3(0.0f, 0.0f, 0.0f)) {}
+
+ProgressivePixel::ProgressivePixel(float initialRadius) :
+    radius(initialRadius), photonCount(0.0f), flux(glm::vec3(0.0f, 0.0f, 0.0f)) {}
+
+static RTCRayHit CreateRayHit(glm::vec3 origin, glm::vec3 direction, float near, float far)
+{
+    RTCRayHit rayhit;
+    {
+        rayhit.ray.org_x = origin.x; rayhit.ray.org_y = origin.y; rayhit.ray.org_z = origin.z;
+        rayhit.ray.dir_x = direction.x; rayhit.ray.dir_y = direction.y; rayhit.ray.dir_z = direction.z;
+        rayhit.ray.tnear = near;
+        rayhit.ray.tfar = far;
+        rayhit.ray.time = 0.0f;
+        rayhit.ray.mask = 0xFFFFFFFF;
+        rayhit.ray.flags = 0;
+        rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    }
+
+    return rayhit;
+}
+
+RenderManager::RenderManager(RTCDevice* device, Camera camera, bool smoothShading, u_int32_t multisamplingIterations, u_int16_t maxRayDepth, u_int32_t threadCount) :
+    m_device(device), m_scene(nullptr), m_photonMapper(nullptr), m_threadPool(nullptr),
     m_camera(camera), m_smoothShading(smoothShading),
-    m_multisamplingIterations(multisamplingIterations), m_maxRayDepth(maxRayDepth),
+    m_multisamplingIterations(multisamplingIterations), m_maxRayDepth(maxRayDepth), m_randomSeed(0), m_sampleSequence(SampleSequence::ScrambledSobol),
+    m_integrator(IntegratorType::Recursive), m_photonCacheDirectory(""), m_precomputeIrradiance(false),
     m_meshObjects(std::vector<MeshGeometry*>()), m_sceneLights(std::vector<PointLight>())
 {
     if (m_device != nullptr)
         m_scene = rtcNewScene(*device);
 
-    m_photonMapper = new PhotonMapper(&m_meshObjects, true, 100000, 8);
+    m_threadPool = new ThreadPool(threadCount);
+    m_photonMapper = new PhotonMapper(m_device, &m_meshObjects, m_threadPool, 100000, 25000, 8);
+}
+
+RenderManager::~RenderManager()
+{
+    // The Photon Mapper Builds on the Thread Pool, so it Goes First; the Pool's Destructor Joins its Workers
+    delete m_photonMapper;
+    delete m_threadPool;
 }
 
 void RenderManager::AttachMeshGeometry(MeshGeometry* meshGeometry, glm::vec3 position)
@@ -76,119 +146,534 @@ void RenderManager::AddLight(glm::vec3 position, glm::vec3 colour, float intensi
     m_sceneLights.push_back(sceneLight);
 }
 
+void RenderManager::SetRandomSeed(u_int64_t seed)
+{
+    m_randomSeed = seed;
+    m_photonMapper->SetRandomSeed(seed);
+}
+
+void RenderManager::SetSampleSequence(SampleSequence sequence)
+{
+    m_sampleSequence = sequence;
+    m_photonMapper->SetSampleSequence(sequence);
+}
+
 void RenderManager::RenderScene(std::string outputFileName, u_int32_t imgWidth, u_int32_t imgHeight)
 {
     rtcCommitScene(m_scene);
 
     auto start_p = std::chrono::steady_clock::now();
-    for (PointLight light : m_sceneLights)
+    if (m_photonCacheDirectory.empty() || !m_photonMapper->LoadPhotonCache(m_photonCacheDirectory, m_sceneLights, m_scene))
+    {
+        m_photonMapper->GeneratePhotons(m_sceneLights, m_scene);
+        auto end_t = std::chrono::steady_clock::now();
+        auto millisecondDuration_t = std::chrono::duration_cast<std::chrono::milliseconds>(end_t - start_p).count();
+
+        std::cout << "Seconds Elapsed for Photon Tracing: " << millisecondDuration_t << "ms" << std::endl;
+
+        auto start_b = std::chrono::steady_clock::now();
+        m_photonMapper->BuildPhotonMaps();
+        auto end_b = std::chrono::steady_clock::now();
+        auto millisecondDuration_b = std::chrono::duration_cast<std::chrono::milliseconds>(end_b - start_b).count();
+
+        std::cout << "Seconds Elapsed for Photon Map Building: " << millisecondDuration_b << "ms" << std::endl;
+
+        if (!m_photonCacheDirectory.empty() && !m_photonMapper->SavePhotonCache(m_photonCacheDirectory, m_sceneLights, m_scene))
+            std::cout << "Could not Write the Photon Cache to " << m_photonCacheDirectory << std::endl;
+    }
+
+    if (m_precomputeIrradiance)
     {
-        m_photonMapper->GeneratePhotons(light, m_scene);
+        auto start_i = std::chrono::steady_clock::now();
+        m_photonMapper->PrecomputeIrradiance();
+        auto end_i = std::chrono::steady_clock::now();
+        auto millisecondDuration_i = std::chrono::duration_cast<std::chrono::milliseconds>(end_i - start_i).count();
+
+        std::cout << "Seconds Elapsed for Irradiance Precomputation: " << millisecondDuration_i << "ms" << std::endl;
     }
     auto end_p = std::chrono::steady_clock::now();
     auto millisecondDuration_p = std::chrono::duration_cast<std::chrono::milliseconds>(end_p - start_p).count();
 
     std::cout << "Seconds Elapsed for Photon Mapping: " << millisecondDuration_p << "ms" << std::endl;
 
-    std::vector<glm::vec3> pixels = std::vector<glm::vec3>();
+    std::vector<glm::vec3> pixels = std::vector<glm::vec3>(imgWidth * imgHeight);
+
+    u_int32_t tilesX = (imgWidth + TILE_SIZE - 1) / TILE_SIZE;
+    u_int32_t tilesY = (imgHeight + TILE_SIZE - 1) / TILE_SIZE;
+    std::cout << "Rendering " << tilesX * tilesY << " Tiles on " << m_threadPool->threadCount() << " Threads with the " << (m_integrator == IntegratorType::Wavefront ? "Wavefront" : "Recursive") << " Integrator" << std::endl;
 
     auto start_r = std::chrono::steady_clock::now();
-    for (int y = 0; y < imgHeight; y++)
+    m_threadPool->ParallelFor(tilesX * tilesY, [&](u_int32_t tileID, u_int32_t threadID)
+    {
+        if (m_integrator == IntegratorType::Wavefront)
+            RenderTileWavefront(pixels, tileID % tilesX, tileID / tilesX, imgWidth, imgHeight);
+        else
+            RenderTile(pixels, tileID % tilesX, tileID / tilesX, imgWidth, imgHeight);
+    });
+    auto end_r = std::chrono::steady_clock::now();
+    auto millisecondDuration_r = std::chrono::duration_cast<std::chrono::milliseconds>(end_r - start_r).count();
+
+    std::cout << "Seconds Elapsed for Rendering: " << millisecondDuration_r << "ms" << std::endl;
+
+    WriteToPPM(outputFileName, imgWidth, imgHeight, pixels);
+}
+
+void RenderManager::RenderSceneProgressive(std::string outputFileName, u_int32_t imgWidth, u_int32_t imgHeight, u_int32_t passCount, int photonsPerPass)
+{
+    rtcCommitScene(m_scene);
+
+    // Memory is Fixed by the Image Size and the Photons per Pass, however many Passes are Rendered
+    float initialRadius = m_photonMapper->photonMap(PhotonMapType::Progressive).gatherRadius();
+    std::vector<VisiblePoint> visiblePoints = std::vector<VisiblePoint>(imgWidth * imgHeight);
+    std::vector<ProgressivePixel> progressivePixels = std::vector<ProgressivePixel>(imgWidth * imgHeight, ProgressivePixel(initialRadius));
+    std::vector<glm::vec3> pixels = std::vector<glm::vec3>(imgWidth * imgHeight);
+
+    u_int32_t tilesX = (imgWidth + TILE_SIZE - 1) / TILE_SIZE;
+    u_int32_t tilesY = (imgHeight + TILE_SIZE - 1) / TILE_SIZE;
+    std::cout << "Rendering " << passCount << " Progressive Passes of " << photonsPerPass << " Photons on " << m_threadPool->threadCount() << " Threads" << std::endl;
+
+    auto start_r = std::chrono::steady_clock::now();
+    for (u_int32_t pass = 0; pass < passCount; pass++)
+    {
+        m_threadPool->ParallelFor(tilesX * tilesY, [&](u_int32_t tileID, u_int32_t threadID)
+        {
+            TraceVisiblePoints(visiblePoints, tileID % tilesX, tileID / tilesX, imgWidth, imgHeight, pass);
+        });
+
+        m_photonMapper->GenerateProgressivePass(m_sceneLights, m_scene, photonsPerPass);
+
+        m_threadPool->ParallelFor(tilesX * tilesY, [&](u_int32_t tileID, u_int32_t threadID)
+        {
+            GatherProgressivePhotons(visiblePoints, progressivePixels, pixels, tileID % tilesX, tileID / tilesX, imgWidth, imgHeight, pass + 1);
+        });
+
+        // The Image so far is Written at every Power of Two, so a Long Render can be Inspected or Stopped at any Point
+        if (((pass + 1) & pass) == 0 || pass + 1 == passCount)
+            WriteToPPM(outputFileName, imgWidth, imgHeight, pixels);
+    }
+    auto end_r = std::chrono::steady_clock::now();
+    auto millisecondDuration_r = std::chrono::duration_cast<std::chrono::milliseconds>(end_r - start_r).count();
+
+    std::cout << "Seconds Elapsed for Rendering: " << millisecondDuration_r << "ms" << std::endl;
+}
+
+void RenderManager::RenderTile(std::vector<glm::vec3>& pixels, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight)
+{
+    // Every Worker Traces with its own Contexts, and Writes only the Pixels of its Tile
+    RTCIntersectContext primaryContext;
+    rtcInitIntersectContext(&primaryContext);
+    primaryContext.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+
+    // One Sample Stream per Packet Lane, as each Lane Continues as its own Path after the Primary Hit
+    std::vector<Sampler> samplers = std::vector<Sampler>(PACKET_SIZE, Sampler(m_randomSeed, m_sampleSequence));
+
+    u_int32_t xEnd = glm::min((tileX + 1) * TILE_SIZE, imgWidth);
+    u_int32_t yEnd = glm::min((tileY + 1) * TILE_SIZE, imgHeight);
+    for (u_int32_t blockY = tileY * TILE_SIZE; blockY < yEnd; blockY += PACKET_HEIGHT)
     {
-        for (int x = 0; x < imgWidth; x++)
+        for (u_int32_t blockX = tileX * TILE_SIZE; blockX < xEnd; blockX += PACKET_WIDTH)
         {
-            glm::vec3 pixelColour(0.0f, 0.0f, 0.0f);
+            glm::vec3 blockColours[PACKET_SIZE];
+            for (u_int32_t lane = 0; lane < PACKET_SIZE; lane++)
+                blockColours[lane] = glm::vec3(0.0f, 0.0f, 0.0f);
+
             for (int i = 0; i < m_multisamplingIterations; i++)
             {
-                //std::cout << "Pixel (" << x << ", " << y << "): Iteration #" << i << std::endl;
-                RTCIntersectContext context;
-                rtcInitIntersectContext(&context);
+                alignas(32) int valid[PACKET_SIZE];
+                RTCRayHit8 packet;
+                for (u_int32_t lane = 0; lane < PACKET_SIZE; lane++)
+                {
+                    u_int32_t x = blockX + (lane % PACKET_WIDTH);
+                    u_int32_t y = blockY + (lane / PACKET_WIDTH);
+
+                    valid[lane] = (x < xEnd && y < yEnd) ? -1 : 0;
+                    if (valid[lane] == 0)
+                        continue;
+
+                    samplers[lane].StartPixelSample(x, y, i);
+                    glm::vec3 rayDirection = m_camera.getPixelRayDirection(x, y, imgWidth, imgHeight, samplers[lane].Get2D());
+
+                    packet.ray.org_x[lane] = m_camera.position.x; packet.ray.org_y[lane] = m_camera.position.y; packet.ray.org_z[lane] = m_camera.position.z;
+                    packet.ray.dir_x[lane] = rayDirection.x; packet.ray.dir_y[lane] = rayDirection.y; packet.ray.dir_z[lane] = rayDirection.z;
+                    packet.ray.tnear[lane] = m_camera.nearPlane;
+                    packet.ray.tfar[lane] = m_camera.farPlane;
+                    packet.ray.time[lane] = 0.0f;
+                    packet.ray.mask[lane] = 0xFFFFFFFF;
+                    packet.ray.flags[lane] = 0;
+                    packet.hit.geomID[lane] = RTC_INVALID_GEOMETRY_ID;
+                }
+
+                rtcIntersect8(valid, m_scene, &primaryContext, &packet);
+
+                for (u_int32_t lane = 0; lane < PACKET_SIZE; lane++)
+                {
+                    if (valid[lane] == 0)
+                        continue;
+
+                    RTCRayHit rayhit;
+                    {
+                        rayhit.ray.org_x = packet.ray.org_x[lane]; rayhit.ray.org_y = packet.ray.org_y[lane]; rayhit.ray.org_z = packet.ray.org_z[lane];
+                        rayhit.ray.dir_x = packet.ray.dir_x[lane]; rayhit.ray.dir_y = packet.ray.dir_y[lane]; rayhit.ray.dir_z = packet.ray.dir_z[lane];
+                        rayhit.ray.tnear = packet.ray.tnear[lane];
+                        rayhit.ray.tfar = packet.ray.tfar[lane];
+                        rayhit.hit.Ng_x = packet.hit.Ng_x[lane]; rayhit.hit.Ng_y = packet.hit.Ng_y[lane]; rayhit.hit.Ng_z = packet.hit.Ng_z[lane];
+                        rayhit.hit.u = packet.hit.u[lane]; rayhit.hit.v = packet.hit.v[lane];
+                        rayhit.hit.primID = packet.hit.primID[lane];
+                        rayhit.hit.geomID = packet.hit.geomID[lane];
+                    }
+
+                    blockColours[lane] += ShadeHit(rayhit, context, samplers[lane], 0);
+                }
+            }
 
-                pixelColour += CastRay(m_camera.position, m_camera.getPixelRayDirection(x, y, imgWidth, imgHeight), m_camera.nearPlane, m_camera.farPlane, context, 0);
+            for (u_int32_t lane = 0; lane < PACKET_SIZE; lane++)
+            {
+                u_int32_t x = blockX + (lane % PACKET_WIDTH);
+                u_int32_t y = blockY + (lane / PACKET_WIDTH);
+                if (x >= xEnd || y >= yEnd)
+                    continue;
+
+                glm::vec3 pixelColour = blockColours[lane];
+                pixelColour.r = pixelColour.r / (float)m_multisamplingIterations;
+                pixelColour.g = pixelColour.g / (float)m_multisamplingIterations;
+                pixelColour.b = pixelColour.b / (float)m_multisamplingIterations;
+                pixels[y * imgWidth + x] = pixelColour;
             }
-            
+        }
+    }
+}
+
+void RenderManager::RenderTileWavefront(std::vector<glm::vec3>& pixels, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight)
+{
+    RTCIntersectContext primaryContext;
+    rtcInitIntersectContext(&primaryContext);
+    primaryContext.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+
+    u_int32_t xBegin = tileX * TILE_SIZE, xEnd = glm::min((tileX + 1) * TILE_SIZE, imgWidth);
+    u_int32_t yBegin = tileY * TILE_SIZE, yEnd = glm::min((tileY + 1) * TILE_SIZE, imgHeight);
+    u_int32_t pathCount = (xEnd - xBegin) * (yEnd - yBegin) * m_multisamplingIterations;
+
+    std::vector<glm::vec3> tileColours = std::vector<glm::vec3>(TILE_SIZE * TILE_SIZE, glm::vec3(0.0f, 0.0f, 0.0f));
+
+    std::vector<WavefrontPath> paths, nextPaths;
+    std::vector<RTCRayHit> rayhits, nextRayhits;
+    paths.reserve(pathCount); nextPaths.reserve(pathCount);
+    rayhits.reserve(pathCount); nextRayhits.reserve(pathCount);
+
+    // Queue a Camera Ray for every Sample of every Pixel in the Tile
+    Sampler sampler(m_randomSeed, m_sampleSequence);
+    for (u_int32_t y = yBegin; y < yEnd; y++)
+    {
+        for (u_int32_t x = xBegin; x < xEnd; x++)
+        {
+            for (int i = 0; i < m_multisamplingIterations; i++)
+            {
+                sampler.StartPixelSample(x, y, i);
+                glm::vec3 rayDirection = m_camera.getPixelRayDirection(x, y, imgWidth, imgHeight, sampler.Get2D());
+
+                paths.push_back(WavefrontPath((y - yBegin) * TILE_SIZE + (x - xBegin), sampler));
+                rayhits.push_back(CreateRayHit(m_camera.position, rayDirection, m_camera.nearPlane, m_camera.farPlane));
+            }
+        }
+    }
+
+    rtcIntersect1M(m_scene, &primaryContext, rayhits.data(), rayhits.size(), sizeof(RTCRayHit));
+
+    // Each Bounce Shades the whole Queue, then Traces the Surviving Paths as one Stream
+    while (!paths.empty())
+    {
+        nextPaths.clear();
+        nextRayhits.clear();
+
+        ShadeWavefrontHits(paths, rayhits, tileColours, nextPaths, nextRayhits);
+
+        paths.swap(nextPaths);
+        rayhits.swap(nextRayhits);
+
+        if (!rayhits.empty())
+            rtcIntersect1M(m_scene, &context, rayhits.data(), rayhits.size(), sizeof(RTCRayHit));
+    }
+
+    for (u_int32_t y = yBegin; y < yEnd; y++)
+    {
+        for (u_int32_t x = xBegin; x < xEnd; x++)
+        {
+            glm::vec3 pixelColour = tileColours[(y - yBegin) * TILE_SIZE + (x - xBegin)];
             pixelColour.r = pixelColour.r / (float)m_multisamplingIterations;
             pixelColour.g = pixelColour.g / (float)m_multisamplingIterations;
             pixelColour.b = pixelColour.b / (float)m_multisamplingIterations;
-            pixels.push_back(pixelColour);
+            pixels[y * imgWidth + x] = pixelColour;
         }
     }
-    auto end_r = std::chrono::steady_clock::now();
-    auto millisecondDuration_r = std::chrono::duration_cast<std::chrono::milliseconds>(end_r - start_r).count();
+}
 
-    std::cout << "Seconds Elapsed for Rendering: " << millisecondDuration_r << "ms" << std::endl;
+void RenderManager::TraceVisiblePoints(std::vector<VisiblePoint>& visiblePoints, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight, u_int32_t pass)
+{
+    RTCIntersectContext primaryContext;
+    rtcInitIntersectContext(&primaryContext);
+    primaryContext.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
 
-    WriteToPPM(outputFileName, imgWidth, imgHeight, pixels);
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+
+    u_int32_t xBegin = tileX * TILE_SIZE, xEnd = glm::min((tileX + 1) * TILE_SIZE, imgWidth);
+    u_int32_t yBegin = tileY * TILE_SIZE, yEnd = glm::min((tileY + 1) * TILE_SIZE, imgHeight);
+
+    std::vector<glm::vec3> tileColours = std::vector<glm::vec3>(TILE_SIZE * TILE_SIZE, glm::vec3(0.0f, 0.0f, 0.0f));
+    std::vector<VisiblePoint> tileVisiblePoints = std::vector<VisiblePoint>(TILE_SIZE * TILE_SIZE);
+
+    std::vector<WavefrontPath> paths, nextPaths;
+    std::vector<RTCRayHit> rayhits, nextRayhits;
+
+    // One Camera Path per Pixel, Jittered Differently each Pass, Followed through Glass by the Wavefront Integrator
+    Sampler sampler(m_randomSeed, m_sampleSequence);
+    for (u_int32_t y = yBegin; y < yEnd; y++)
+    {
+        for (u_int32_t x = xBegin; x < xEnd; x++)
+        {
+            sampler.StartPixelSample(x, y, pass);
+            glm::vec3 rayDirection = m_camera.getPixelRayDirection(x, y, imgWidth, imgHeight, sampler.Get2D());
+
+            paths.push_back(WavefrontPath((y - yBegin) * TILE_SIZE + (x - xBegin), sampler));
+            rayhits.push_back(CreateRayHit(m_camera.position, rayDirection, m_camera.nearPlane, m_camera.farPlane));
+        }
+    }
+
+    rtcIntersect1M(m_scene, &primaryContext, rayhits.data(), rayhits.size(), sizeof(RTCRayHit));
+
+    while (!paths.empty())
+    {
+        nextPaths.clear();
+        nextRayhits.clear();
+
+        ShadeWavefrontHits(paths, rayhits, tileColours, nextPaths, nextRayhits, &tileVisiblePoints);
+
+        paths.swap(nextPaths);
+        rayhits.swap(nextRayhits);
+
+        if (!rayhits.empty())
+            rtcIntersect1M(m_scene, &context, rayhits.data(), rayhits.size(), sizeof(RTCRayHit));
+    }
+
+    for (u_int32_t y = yBegin; y < yEnd; y++)
+    {
+        for (u_int32_t x = xBegin; x < xEnd; x++)
+            visiblePoints[y * imgWidth + x] = tileVisiblePoints[(y - yBegin) * TILE_SIZE + (x - xBegin)];
+    }
 }
 
-glm::vec3 RenderManager::CastRay(glm::vec3 origin, glm::vec3 direction, float near, float far, RTCIntersectContext& context, u_int16_t rayDepth)
+void RenderManager::GatherProgressivePhotons(std::vector<VisiblePoint>& visiblePoints, std::vector<ProgressivePixel>& progressivePixels, std::vector<glm::vec3>& pixels, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight, u_int32_t passCount)
 {
-    RTCRayHit rayhit;
+    u_int32_t xBegin = tileX * TILE_SIZE, xEnd = glm::min((tileX + 1) * TILE_SIZE, imgWidth);
+    u_int32_t yBegin = tileY * TILE_SIZE, yEnd = glm::min((tileY + 1) * TILE_SIZE, imgHeight);
+
+    for (u_int32_t y = yBegin; y < yEnd; y++)
     {
-        rayhit.ray.org_x = origin.x; rayhit.ray.org_y = origin.y; rayhit.ray.org_z = origin.z;
-        rayhit.ray.dir_x = direction.x; rayhit.ray.dir_y = direction.y; rayhit.ray.dir_z = direction.z;
-        rayhit.ray.tnear = near;
-        rayhit.ray.tfar = far;
-        rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+        for (u_int32_t x = xBegin; x < xEnd; x++)
+        {
+            const VisiblePoint& visiblePoint = visiblePoints[y * imgWidth + x];
+            ProgressivePixel& pixel = progressivePixels[y * imgWidth + x];
+
+            if (visiblePoint.valid)
+            {
+                // Sums the Flux the Visible Point Receives from the Photons within its Radius
+                glm::vec3 power;
+                u_int32_t newPhotons = m_photonMapper->GatherFacingPower(PhotonMapType::Progressive, visiblePoint.position, pixel.radius, visiblePoint.normal, power);
+
+                // Keep only a Fraction of the New Photons, Shrinking the Radius to Match, and Rescale the Flux to the Smaller Disc
+                if (newPhotons > 0)
+                {
+                    float photonCount = pixel.photonCount + (PROGRESSIVE_ALPHA * newPhotons);
+                    float radius = pixel.radius * glm::sqrt(photonCount / (pixel.photonCount + newPhotons));
+
+                    pixel.flux = (pixel.flux + (visiblePoint.weight * power)) * ((radius * radius) / (pixel.radius * pixel.radius));
+                    pixel.photonCount = photonCount;
+                    pixel.radius = radius;
+                }
+            }
+
+            // Each Pass's Photons Carry the Light's Full Power, so the Estimate Averages over Passes
+            pixels[y * imgWidth + x] = pixel.flux / (glm::pi<float>() * pixel.radius * pixel.radius * (float)passCount);
+        }
     }
+}
 
-    rtcIntersect1(m_scene, &context, &rayhit);
+void RenderManager::ShadeWavefrontHits(std::vector<WavefrontPath>& paths, std::vector<RTCRayHit>& rayhits, std::vector<glm::vec3>& tileColours, std::vector<WavefrontPath>& nextPaths, std::vector<RTCRayHit>& nextRayhits, std::vector<VisiblePoint>* visiblePoints)
+{
+    std::vector<PhotonShadingPoint> shadingPoints;
+    std::vector<glm::vec3> shadingPositions;
+    std::vector<glm::vec3> shadingNormals;
 
-    if (rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID)
+    for (u_int32_t p = 0; p < paths.size(); p++)
     {
-        MeshGeometry* hitMesh = m_meshObjects[rayhit.hit.geomID];
-        MaterialProperties surfaceProperties = hitMesh->properties();
+        WavefrontPath path = paths[p];
+        RTCRayHit& rayhit = rayhits[p];
+
+        // Terminated Paths are Dropped here, Compacting the Next Queue
+        if (rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+            continue;
 
-        glm::vec3 hitPoint(0.0f, 0.0f, 0.0f);
+        if (path.refractiveIndex == 0.0f)
         {
-            hitPoint.x = rayhit.ray.org_x + rayhit.ray.dir_x * rayhit.ray.tfar;
-            hitPoint.y = rayhit.ray.org_y + rayhit.ray.dir_y * rayhit.ray.tfar;
-            hitPoint.z = rayhit.ray.org_z + rayhit.ray.dir_z * rayhit.ray.tfar;
+            MaterialProperties surfaceProperties = getMeshGeometryProperties(rayhit.hit.geomID);
+
+            glm::vec3 hitPoint, surfaceNormal, reflectionDirection, incidentDirection;
+            GetSurfaceInteraction(rayhit, path.sampler, hitPoint, surfaceNormal, reflectionDirection, incidentDirection);
+
+            double randChoice = path.sampler.Get1D();
+            if ((randChoice > surfaceProperties.glassiness || surfaceProperties.glassiness == 0.0f) && visiblePoints != nullptr)
+            {
+                // Progressive Camera Passes Stop at the Diffuse Surface, which Photons are then Gathered at
+                VisiblePoint& visiblePoint = (*visiblePoints)[path.pixelIndex];
+                {
+                    visiblePoint.valid = true;
+                    visiblePoint.position = hitPoint;
+                    visiblePoint.normal = glm::normalize(surfaceNormal);
+                    visiblePoint.weight = (path.throughput * surfaceProperties.albedoColour) / glm::pi<float>();
+                }
+            }
+            else if (randChoice > surfaceProperties.glassiness || surfaceProperties.glassiness == 0.0f)
+            {
+                // Photon Estimates are Deferred, so the whole Bounce's Diffuse Hits can be Gathered as one Batch
+                PhotonShadingPoint shadingPoint;
+                {
+                    shadingPoint.pixelIndex = path.pixelIndex;
+                    shadingPoint.normal = glm::normalize(surfaceNormal);
+                    shadingPoint.weight = (path.throughput * surfaceProperties.albedoColour) / glm::pi<float>();
+                }
+                shadingPoints.push_back(shadingPoint);
+                shadingPositions.push_back(hitPoint);
+                shadingNormals.push_back(shadingPoint.normal);
+            }
+            else if (path.rayDepth < m_maxRayDepth)
+            {
+                path.throughput *= surfaceProperties.albedoColour;
+
+                float randChoice = path.sampler.Get1D();
+                if (randChoice > surfaceProperties.translucency || surfaceProperties.translucency == 0.0f)
+                {
+                    path.rayDepth++;
+
+                    nextPaths.push_back(path);
+                    nextRayhits.push_back(CreateRayHit(hitPoint, reflectionDirection, 0.01f, std::numeric_limits<float>().infinity()));
+                }
+                else
+                {
+                    path.refractiveIndex = surfaceProperties.refractiveIndex;
+                    path.internalReflections = 0;
+
+                    glm::vec3 refractionDirection = GetRefractionDirection(surfaceNormal, incidentDirection, surfaceProperties.refractiveIndex);
+
+                    nextPaths.push_back(path);
+                    nextRayhits.push_back(CreateRayHit(hitPoint, refractionDirection, 0.01f, std::numeric_limits<float>().infinity()));
+                }
+            }
         }
-        glm::vec3 surfaceNormal(0.0f, 0.0f, 0.0f);
+        else
         {
-            surfaceNormal.x = rayhit.hit.Ng_x;
-            surfaceNormal.y = rayhit.hit.Ng_y;
-            surfaceNormal.z = rayhit.hit.Ng_z;
-            //std::cout << "NormX: " << surfaceNormal.x << ", NormY: " << surfaceNormal.y << ", NormZ: " << surfaceNormal.z << std::endl;
-            if (m_smoothShading)
+            // Path is Leaving Glass: Refract Out, or Reflect Internally
+            glm::vec3 direction(rayhit.ray.dir_x, rayhit.ray.dir_y, rayhit.ray.dir_z);
+            glm::vec3 newHitPoint;
             {
-                float a, b, c;
-                hitMesh->CalculateBarycentricOfFace(rayhit.hit.primID, hitPoint, a, b, c);
+                newHitPoint.x = rayhit.ray.org_x + (rayhit.ray.dir_x * rayhit.ray.tfar);
+                newHitPoint.y = rayhit.ray.org_y + (rayhit.ray.dir_y * rayhit.ray.tfar);
+                newHitPoint.z = rayhit.ray.org_z + (rayhit.ray.dir_z * rayhit.ray.tfar);
+            }
+            glm::vec3 exitNormal = GetSurfaceNormal(rayhit, newHitPoint);
+
+            float interiorAngleSin = glm::sin(glm::acos(glm::dot(glm::normalize(exitNormal), glm::normalize(direction))));
+            float exitAngleSin = path.refractiveIndex * interiorAngleSin;
 
-                glm::uvec3 hitFace = hitMesh->faceNIDs()[rayhit.hit.primID];
-                surfaceNormal = (glm::normalize(hitMesh->normals()[hitFace.x]) * a) + (glm::normalize(hitMesh->normals()[hitFace.y]) * b) + (glm::normalize(hitMesh->normals()[hitFace.z]) * c);
-                surfaceNormal = glm::normalize(surfaceNormal);
+            if (exitAngleSin <= 1.0f)
+            {
+                glm::vec3 exitPerpendicular = glm::cross(glm::normalize(exitNormal), glm::normalize(direction));
+                glm::vec3 exitDirection = glm::normalize(exitNormal) * glm::angleAxis(glm::asin(-exitAngleSin), glm::normalize(exitPerpendicular));
+
+                path.rayDepth += path.internalReflections;
+                path.refractiveIndex = 0.0f;
+
+                nextPaths.push_back(path);
+                nextRayhits.push_back(CreateRayHit(newHitPoint, exitDirection, 0.01f, std::numeric_limits<float>().infinity()));
+            }
+            else if (path.internalReflections + path.rayDepth < m_maxRayDepth)
+            {
+                path.internalReflections++;
+                glm::vec3 internalReflectionDirection = direction - (2 * glm::dot(glm::normalize(direction), glm::normalize(-exitNormal)) * -exitNormal);
+
+                nextPaths.push_back(path);
+                nextRayhits.push_back(CreateRayHit(newHitPoint, internalReflectionDirection, 0.01f, std::numeric_limits<float>().infinity()));
             }
-            //std::cout << "SmoothX: " << surfaceNormal.x << ", SmoothY: " << surfaceNormal.y << ", SmoothZ: " << surfaceNormal.z << std::endl;
-            //std::cout << std::endl;
         }
-        glm::vec3 reflectionDirection = direction - (2 * glm::dot(glm::normalize(direction), glm::normalize(surfaceNormal)) * surfaceNormal);
-        glm::vec3 incidentDirection = glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    // Gathered in Morton Order, so Nearby Shading Points Reuse each other's Photons while they are still in Cache
+    // A Map with Precomputed Irradiance needs only one Fetch per Point, and Gathers only where there is None to Fetch
+    for (PhotonMapType mapType : { PhotonMapType::Caustic, PhotonMapType::Global })
+    {
+        const PhotonMap& photonMap = m_photonMapper->photonMap(mapType);
+        TilePhotonEstimate estimate = { shadingPoints, tileColours, photonMap };
+        if (!photonMap.hasIrradiance())
         {
-            glm::vec3 randomDirection = glm::normalize(glm::sphericalRand(1.0f));
-            if (randomDirection == -glm::normalize(surfaceNormal) || glm::dot(randomDirection, glm::normalize(surfaceNormal)) < 0.0f)
-                randomDirection = -randomDirection;
+            photonMap.GatherPhotonsBatch(shadingPositions, threadPhotonGatherBatch, estimate, &shadingNormals);
+            continue;
+        }
 
-            float angle = glm::acos(glm::dot(reflectionDirection, randomDirection));
-            angle *= surfaceProperties.roughness;
+        PhotonGather& gather = threadPhotonGather;
+        for (u_int32_t i = 0; i < shadingPoints.size(); i++)
+        {
+            glm::vec3 irradiance;
+            if (photonMap.LookupIrradiance(shadingPositions[i], shadingNormals[i], gather, irradiance))
+                tileColours[shadingPoints[i].pixelIndex] += shadingPoints[i].weight * irradiance;
+            else
+            {
+                photonMap.GatherPhotons(shadingPositions[i], shadingNormals[i], gather);
+                estimate(i, gather);
+            }
+        }
+    }
+}
 
-            glm::vec3 perpendicular = glm::cross(reflectionDirection, randomDirection);
-            reflectionDirection = reflectionDirection * glm::angleAxis(angle, glm::normalize(perpendicular));
+glm::vec3 RenderManager::CastRay(glm::vec3 origin, glm::vec3 direction, float near, float far, RTCIntersectContext& context, Sampler& sampler, u_int16_t rayDepth)
+{
+    RTCRayHit rayhit;
+    {
+        rayhit.ray.org_x = origin.x; rayhit.ray.org_y = origin.y; rayhit.ray.org_z = origin.z;
+        rayhit.ray.dir_x = direction.x; rayhit.ray.dir_y = direction.y; rayhit.ray.dir_z = direction.z;
+        rayhit.ray.tnear = near;
+        rayhit.ray.tfar = far;
+        rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    }
 
-            incidentDirection = reflectionDirection - (2 * glm::dot(glm::normalize(reflectionDirection), glm::normalize(-surfaceNormal)) * (-surfaceNormal));
-        }
+    rtcIntersect1(m_scene, &context, &rayhit);
+
+    return ShadeHit(rayhit, context, sampler, rayDepth);
+}
+
+glm::vec3 RenderManager::ShadeHit(RTCRayHit& rayhit, RTCIntersectContext& context, Sampler& sampler, u_int16_t rayDepth)
+{
+    if (rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID)
+    {
+        MaterialProperties surfaceProperties = getMeshGeometryProperties(rayhit.hit.geomID);
+
+        glm::vec3 hitPoint, surfaceNormal, reflectionDirection, incidentDirection;
+        GetSurfaceInteraction(rayhit, sampler, hitPoint, surfaceNormal, reflectionDirection, incidentDirection);
 
-        double randChoice = glm::linearRand(0.0f, 1.0f);
+        double randChoice = sampler.Get1D();
 
         if (randChoice > surfaceProperties.glassiness || surfaceProperties.glassiness == 0.0f)
         {
+            // The Maps Hold Photons from every Light, so each is Estimated once rather than once per Light
             glm::vec3 diffuseColour(0.0f, 0.0f, 0.0f);
-            for (int i = 0; i < m_sceneLights.size(); i++)
-            {
-                //diffuseColour += CalculateDiffuseColour(hitPoint, surfaceNormal, reflectionDirection, m_sceneLights[i], surfaceProperties, context);
-                diffuseColour += CalculateCausticColour(hitPoint, surfaceNormal, reflectionDirection, m_sceneLights[i], surfaceProperties, context);
-            }
+            //for (int i = 0; i < m_sceneLights.size(); i++)
+            //    diffuseColour += CalculateDiffuseColour(hitPoint, surfaceNormal, reflectionDirection, m_sceneLights[i], surfaceProperties, context);
+            diffuseColour += EstimatePhotonRadiance(PhotonMapType::Caustic, hitPoint, surfaceNormal, surfaceProperties);
+            diffuseColour += EstimatePhotonRadiance(PhotonMapType::Global, hitPoint, surfaceNormal, surfaceProperties);
 
             // glm::vec3 ambientColour(0.0f, 0.0f, 0.0f);
             // if (rayDepth < m_maxRayDepth)
@@ -205,14 +690,14 @@ glm::vec3 RenderManager::CastRay(glm::vec3 origin, glm::vec3 direction, float ne
             glm::vec3 glassyColour(0.0f, 0.0f, 0.0f); // The Reflection/Refraction Colour
             if (rayDepth < m_maxRayDepth)
             {
-                float randChoice = glm::linearRand(0.0f, 1.0f);
+                float randChoice = sampler.Get1D();
                 if (randChoice > surfaceProperties.translucency || surfaceProperties.translucency == 0.0f)
                 {
-                    glassyColour = CalculateReflectionColour(hitPoint, reflectionDirection, surfaceProperties, context, rayDepth + 1);
+                    glassyColour = CalculateReflectionColour(hitPoint, reflectionDirection, surfaceProperties, context, sampler, rayDepth + 1);
                 }
                 else
                 {
-                    glassyColour = CalculateRefractionColour(hitPoint, surfaceNormal, incidentDirection, surfaceProperties, context, rayDepth);
+                    glassyColour = CalculateRefractionColour(hitPoint, surfaceNormal, incidentDirection, surfaceProperties, context, sampler, rayDepth);
                 }
             }
 
@@ -223,46 +708,83 @@ glm::vec3 RenderManager::CastRay(glm::vec3 origin, glm::vec3 direction, float ne
     return glm::vec3(0.0f, 0.0f, 0.0f);
 }
 
-glm::vec3 RenderManager::CalculateCausticColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 reflectionDirection, PointLight light, MaterialProperties surfaceProperties, RTCIntersectContext& context)
+void RenderManager::GetSurfaceInteraction(RTCRayHit& rayhit, Sampler& sampler, glm::vec3& hitPoint, glm::vec3& surfaceNormal, glm::vec3& reflectionDirection, glm::vec3& incidentDirection)
 {
-    float photonRangeRadius = 0.05f;
-    float kValue = 0.8f;
+    glm::vec3 direction(rayhit.ray.dir_x, rayhit.ray.dir_y, rayhit.ray.dir_z);
+    MaterialProperties surfaceProperties = getMeshGeometryProperties(rayhit.hit.geomID);
 
-    glm::vec3 causticsColour(0.0f, 0.0f, 0.0f);
-    //auto photons = m_photonMapper->GetClosestPhotons(hitPoint, photonRangeRadius);
-    auto photons = m_photonMapper->GetClosestPhotons(hitPoint, 100, photonRangeRadius);
-    for (auto p : photons)
     {
-        glm::vec3 photonPos(p.point[0], p.point[1], p.point[2]);
-        float distance = glm::distance(photonPos, hitPoint);
-        PhotonData* data = (PhotonData*)p.data;
-        
-        float facingRatio = glm::dot(glm::normalize(data->direction), glm::normalize(surfaceNormal));
-        if (facingRatio <= 0.0f)
-            continue;
+        hitPoint.x = rayhit.ray.org_x + rayhit.ray.dir_x * rayhit.ray.tfar;
+        hitPoint.y = rayhit.ray.org_y + rayhit.ray.dir_y * rayhit.ray.tfar;
+        hitPoint.z = rayhit.ray.org_z + rayhit.ray.dir_z * rayhit.ray.tfar;
+    }
+    surfaceNormal = GetSurfaceNormal(rayhit, hitPoint);
 
-        float photonWeight = 1 - (distance / (kValue * photonRangeRadius));
-        if (photonWeight < 0.0f)
-            photonWeight = 0.0f;
+    reflectionDirection = direction - (2 * glm::dot(glm::normalize(direction), glm::normalize(surfaceNormal)) * surfaceNormal);
+    {
+        glm::vec3 randomDirection = sampler.GetUnitSphere();
+        if (randomDirection == -glm::normalize(surfaceNormal) || glm::dot(randomDirection, glm::normalize(surfaceNormal)) < 0.0f)
+            randomDirection = -randomDirection;
+
+        float angle = glm::acos(glm::dot(reflectionDirection, randomDirection));
+        angle *= surfaceProperties.roughness;
+
+        glm::vec3 perpendicular = glm::cross(reflectionDirection, randomDirection);
+        reflectionDirection = reflectionDirection * glm::angleAxis(angle, glm::normalize(perpendicular));
+
+        incidentDirection = reflectionDirection - (2 * glm::dot(glm::normalize(reflectionDirection), glm::normalize(-surfaceNormal)) * (-surfaceNormal));
+    }
+}
 
-        glm::vec3 pointColour(0.0f, 0.0f, 0.0f);
+glm::vec3 RenderManager::GetSurfaceNormal(RTCRayHit& rayhit, glm::vec3 hitPoint)
+{
+    glm::vec3 surfaceNormal(0.0f, 0.0f, 0.0f);
+    {
+        surfaceNormal.x = rayhit.hit.Ng_x;
+        surfaceNormal.y = rayhit.hit.Ng_y;
+        surfaceNormal.z = rayhit.hit.Ng_z;
+        //std::cout << "NormX: " << surfaceNormal.x << ", NormY: " << surfaceNormal.y << ", NormZ: " << surfaceNormal.z << std::endl;
+        if (m_smoothShading)
         {
-            pointColour.r = (surfaceProperties.albedoColour.r * facingRatio * data->colour.r) / glm::pi<float>();
-            pointColour.g = (surfaceProperties.albedoColour.g * facingRatio * data->colour.g) / glm::pi<float>();
-            pointColour.b = (surfaceProperties.albedoColour.b * facingRatio * data->colour.b) / glm::pi<float>();
-        }
+            MeshGeometry* hitMesh = m_meshObjects[rayhit.hit.geomID];
+            float a, b, c;
+            hitMesh->CalculateBarycentricOfFace(rayhit.hit.primID, hitPoint, a, b, c);
 
-        causticsColour += pointColour * photonWeight;
+            glm::uvec3 hitFace = hitMesh->faceNIDs()[rayhit.hit.primID];
+            surfaceNormal = (glm::normalize(hitMesh->normals()[hitFace.x]) * a) + (glm::normalize(hitMesh->normals()[hitFace.y]) * b) + (glm::normalize(hitMesh->normals()[hitFace.z]) * c);
+            surfaceNormal = glm::normalize(surfaceNormal);
+        }
+        //std::cout << "SmoothX: " << surfaceNormal.x << ", SmoothY: " << surfaceNormal.y << ", SmoothZ: " << surfaceNormal.z << std::endl;
+        //std::cout << std::endl;
     }
 
+    return surfaceNormal;
+}
+
+glm::vec3 RenderManager::GetRefractionDirection(glm::vec3 surfaceNormal, glm::vec3 incidenceDirection, float refractiveIndex)
+{
+    float incidenceAngle = glm::acos(glm::dot(glm::normalize(surfaceNormal), glm::normalize(-incidenceDirection)));
+    float refractionAngle = glm::asin(glm::sin(incidenceAngle) / refractiveIndex);
+
+    glm::vec3 perpendicular = glm::cross(glm::normalize(-surfaceNormal), glm::normalize(incidenceDirection));
+    return -surfaceNormal * glm::angleAxis(-refractionAngle, glm::normalize(perpendicular)); // Why the Refraction Angle has to be Negated is Unclear
+}
+
+glm::vec3 RenderManager::EstimatePhotonRadiance(PhotonMapType mapType, glm::vec3 hitPoint, glm::vec3 surfaceNormal, MaterialProperties surfaceProperties)
+{
+    const PhotonMap& photonMap = m_photonMapper->photonMap(mapType);
+
+    // Only Photons that Arrived on this Surface are Gathered, so all gatherNumber of them Contribute
+    glm::vec3 normal = glm::normalize(surfaceNormal);
+    PhotonGather& photons = threadPhotonGather;
+    glm::vec3 irradiance;
+    if (!photonMap.LookupIrradiance(hitPoint, normal, photons, irradiance))
     {
-        // causticsColour.r = (causticsColour.r * 3 * kValue) / (glm::pi<float>() * glm::pow(photonRangeRadius, 2.0f));
-        // causticsColour.g = (causticsColour.g * 3 * kValue) / (glm::pi<float>() * glm::pow(photonRangeRadius, 2.0f));
-        // causticsColour.b = (causticsColour.b * 3 * kValue) / (glm::pi<float>() * glm::pow(photonRangeRadius, 2.0f));
-        causticsColour = causticsColour / ((1.0f - (2.0f / (3 * kValue))) * glm::pi<float>() * glm::pow(photonRangeRadius, 2.0f));
+        photonMap.GatherPhotons(hitPoint, normal, photons);
+        irradiance = photonMap.EstimateIrradiance(photons, normal);
     }
 
-    return causticsColour;
+    return (surfaceProperties.albedoColour / glm::pi<float>()) * irradiance;
 }
 
 glm::vec3 RenderManager::CalculateDiffuseColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 reflectionDirection, PointLight light, MaterialProperties surfaceProperties, RTCIntersectContext& context)
@@ -308,9 +830,9 @@ glm::vec3 RenderManager::CalculateDiffuseColour(glm::vec3 hitPoint, glm::vec3 su
     return glm::vec3(0.0f, 0.0f, 0.0f);
 }
 
-glm::vec3 RenderManager::CalculateReflectionColour(glm::vec3 hitPoint, glm::vec3 reflectionDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, u_int32_t rayDepth)
+glm::vec3 RenderManager::CalculateReflectionColour(glm::vec3 hitPoint, glm::vec3 reflectionDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, Sampler& sampler, u_int32_t rayDepth)
 {
-    glm::vec3 reflectionColour = CastRay(hitPoint, reflectionDirection, 0.01f, std::numeric_limits<float>().infinity(), context, rayDepth);
+    glm::vec3 reflectionColour = CastRay(hitPoint, reflectionDirection, 0.01f, std::numeric_limits<float>().infinity(), context, sampler, rayDepth);
     {
         reflectionColour.r *= surfaceProperties.albedoColour.r;
         reflectionColour.g *= surfaceProperties.albedoColour.g;
@@ -320,13 +842,9 @@ glm::vec3 RenderManager::CalculateReflectionColour(glm::vec3 hitPoint, glm::vec3
     return reflectionColour;
 }
 
-glm::vec3 RenderManager::CalculateRefractionColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 incidenceDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, u_int32_t rayDepth)
+glm::vec3 RenderManager::CalculateRefractionColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 incidenceDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, Sampler& sampler, u_int32_t rayDepth)
 {
-    float incidenceAngle = glm::acos(glm::dot(glm::normalize(surfaceNormal), glm::normalize(-incidenceDirection)));
-    float refractionAngle = glm::asin(glm::sin(incidenceAngle) / surfaceProperties.refractiveIndex);
-
-    glm::vec3 perpendicular = glm::cross(glm::normalize(-surfaceNormal), glm::normalize(incidenceDirection));
-    glm::vec3 refractionDirection = -surfaceNormal * glm::angleAxis(-refractionAngle, glm::normalize(perpendicular)); // Why the Refraction Angle has to be Negated is Unclear
+    glm::vec3 refractionDirection = GetRefractionDirection(surfaceNormal, incidenceDirection, surfaceProperties.refractiveIndex);
 
     RTCRayHit refractionRay;
     {
@@ -371,7 +889,7 @@ glm::vec3 RenderManager::CalculateRefractionColour(glm::vec3 hitPoint, glm::vec3
             glm::vec3 exitPerpendicular = glm::cross(glm::normalize(exitNormal), glm::normalize(refractionDirection));
             glm::vec3 exitDirection = glm::normalize(exitNormal) * glm::angleAxis(glm::asin(-exitAngleSin), glm::normalize(exitPerpendicular)); // Why the Refraction Angle has to be Negated is Unclear
 
-            refractionColour = CastRay(newHitPoint, exitDirection, 0.01f, std::numeric_limits<float>().infinity(), context, rayDepth + internalReflections);
+            refractionColour = CastRay(newHitPoint, exitDirection, 0.01f, std::numeric_limits<float>().infinity(), context, sampler, rayDepth + internalReflections);
             break;
         }
         else if (internalReflections + rayDepth < m_maxRayDepth)
@@ -9,6 +9,8 @@
 #include "../IOManagers/MeshGeometry.hpp"
 #include "PointLight.hpp"
 #include "PhotonMapper.hpp"
+#include "ThreadPool.hpp"
+#include "Sampler.hpp"
 
 struct Camera
 {
@@ -23,19 +25,67 @@ public:
     float farPlane;
 
 public:
-    glm::vec3 getPixelRayDirection(int x, int y, u_int16_t imgWidth, u_int16_t imgHeight);
+    glm::vec3 getPixelRayDirection(int x, int y, u_int16_t imgWidth, u_int16_t imgHeight, glm::vec2 pixelOffset);
+};
+
+enum class IntegratorType
+{
+    Recursive,  // Depth-First, one Path at a Time
+    Wavefront   // Breadth-First, Tracing every Live Path of a Tile together each Bounce
+};
+
+// State of a Path Waiting in a Wavefront Ray Queue
+struct WavefrontPath
+{
+    WavefrontPath(u_int32_t pixelIndex, Sampler sampler);
+
+    u_int32_t pixelIndex;
+    glm::vec3 throughput;
+
+    Sampler sampler;
+    u_int16_t rayDepth;
+
+    // Set while the Path Travels Inside Glass
+    float refractiveIndex;
+    u_int16_t internalReflections;
+};
+
+// Diffuse Surface a Camera Path Reached in a Progressive Camera Pass
+struct VisiblePoint
+{
+    VisiblePoint();
+
+    bool valid;
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 weight; // Path Throughput times the Surface's Diffuse Reflectance
+};
+
+// Photon Statistics a Pixel Accumulates over every Progressive Pass (Hachisuka and Jensen 2009)
+struct ProgressivePixel
+{
+    ProgressivePixel(float initialRadius);
+
+    float radius;
+    float photonCount;
+    glm::vec3 flux;
 };
 
 class RenderManager
 {
 public:
-    RenderManager(RTCDevice* device, Camera camera, bool smoothShading, u_int32_t multisamplingIterations, u_int16_t maxRayDepth);
+    RenderManager(RTCDevice* device, Camera camera, bool smoothShading, u_int32_t multisamplingIterations, u_int16_t maxRayDepth, u_int32_t threadCount = 0);
+    ~RenderManager();
 
 private:
+    RenderManager(const RenderManager&);
+    RenderManager& operator=(const RenderManager&);
+
     RTCDevice* m_device;
     RTCScene m_scene;
 
     PhotonMapper* m_photonMapper;
+    ThreadPool* m_threadPool;
 
     Camera m_camera;
     bool m_smoothShading;
@@ -43,6 +93,13 @@ private:
     u_int32_t m_multisamplingIterations;
     u_int16_t m_maxRayDepth;
 
+    u_int64_t m_randomSeed;
+    SampleSequence m_sampleSequence;
+
+    IntegratorType m_integrator;
+    std::string m_photonCacheDirectory; // Empty when Photon Maps are not Cached
+    bool m_precomputeIrradiance;
+
     std::vector<MeshGeometry*> m_meshObjects;
     MaterialProperties getMeshGeometryProperties(int meshGeometryID) { return m_meshObjects[meshGeometryID]->properties(); }
 
@@ -51,15 +108,37 @@ private:
 public:
     void AttachMeshGeometry(MeshGeometry* meshGeometry, glm::vec3 position);
     void AddLight(glm::vec3 position, glm::vec3 colour, float intensity);
+    void SetRandomSeed(u_int64_t seed);
+    void SetSampleSequence(SampleSequence sequence);
+    void SetIntegrator(IntegratorType integrator) { m_integrator = integrator; }
+    void SetPhotonCacheDirectory(std::string directory) { m_photonCacheDirectory = directory; }
+    // Shading then Fetches Irradiance Estimated once at a Subset of Photons, rather than Estimating it at every Hit
+    void SetIrradiancePrecompute(bool precompute) { m_precomputeIrradiance = precompute; }
+    void SetPhotonMapBackend(PhotonMapBackend backend) { m_photonMapper->SetBackend(backend); }
+    void SetPhotonGatherParameters(PhotonMapType mapType, u_int32_t gatherNumber, float gatherRadius) { m_photonMapper->SetGatherParameters(mapType, gatherNumber, gatherRadius); }
 
     void RenderScene(std::string outputFileName, u_int32_t imgWidth, u_int32_t imgHeight);
+    // Stochastic Progressive Photon Mapping: each Pass Traces new Visible Points and new Photons, then Discards the Photons
+    void RenderSceneProgressive(std::string outputFileName, u_int32_t imgWidth, u_int32_t imgHeight, u_int32_t passCount, int photonsPerPass);
 
 private:
+    void RenderTile(std::vector<glm::vec3>& pixels, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight);
+    void RenderTileWavefront(std::vector<glm::vec3>& pixels, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight);
+    void ShadeWavefrontHits(std::vector<WavefrontPath>& paths, std::vector<RTCRayHit>& rayhits, std::vector<glm::vec3>& tileColours, std::vector<WavefrontPath>& nextPaths, std::vector<RTCRayHit>& nextRayhits, std::vector<VisiblePoint>* visiblePoints = nullptr);
+
+    void TraceVisiblePoints(std::vector<VisiblePoint>& visiblePoints, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight, u_int32_t pass);
+    void GatherProgressivePhotons(std::vector<VisiblePoint>& visiblePoints, std::vector<ProgressivePixel>& progressivePixels, std::vector<glm::vec3>& pixels, u_int32_t tileX, u_int32_t tileY, u_int32_t imgWidth, u_int32_t imgHeight, u_int32_t passCount);
+
     //glm::vec3 TraceRay(glm::vec3 origin, glm::vec3 direction, float near, float far, u_int16_t& rayDepth);
-    glm::vec3 CastRay(glm::vec3 origin, glm::vec3 direction, float near, float far, RTCIntersectContext& context, u_int16_t rayDepth);
+    glm::vec3 CastRay(glm::vec3 origin, glm::vec3 direction, float near, float far, RTCIntersectContext& context, Sampler& sampler, u_int16_t rayDepth);
+    glm::vec3 ShadeHit(RTCRayHit& rayhit, RTCIntersectContext& context, Sampler& sampler, u_int16_t rayDepth);
+
+    void GetSurfaceInteraction(RTCRayHit& rayhit, Sampler& sampler, glm::vec3& hitPoint, glm::vec3& surfaceNormal, glm::vec3& reflectionDirection, glm::vec3& incidentDirection);
+    glm::vec3 GetSurfaceNormal(RTCRayHit& rayhit, glm::vec3 hitPoint);
+    glm::vec3 GetRefractionDirection(glm::vec3 surfaceNormal, glm::vec3 incidenceDirection, float refractiveIndex);
 
     glm::vec3 CalculateDiffuseColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 reflectionDirection, PointLight light, MaterialProperties surfaceProperties, RTCIntersectContext& context);
-    glm::vec3 CalculateCausticColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 reflectionDirection, PointLight light, MaterialProperties surfaceProperties, RTCIntersectContext& context);
-    glm::vec3 CalculateReflectionColour(glm::vec3 hitPoint, glm::vec3 reflectionDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, u_int32_t rayDepth);
-    glm::vec3 CalculateRefractionColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 incidenceDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, u_int32_t rayDepth);
+    glm::vec3 EstimatePhotonRadiance(PhotonMapType mapType, glm::vec3 hitPoint, glm::vec3 surfaceNormal, MaterialProperties surfaceProperties);
+    glm::vec3 CalculateReflectionColour(glm::vec3 hitPoint, glm::vec3 reflectionDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, Sampler& sampler, u_int32_t rayDepth);
+    glm::vec3 CalculateRefractionColour(glm::vec3 hitPoint, glm::vec3 surfaceNormal, glm::vec3 incidenceDirection, MaterialProperties surfaceProperties, RTCIntersectContext& context, Sampler& sampler, u_int32_t rayDepth);
 };
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "Sampler.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#define PIXEL_STREAM_DOMAIN 0x5049584Cull
+#define PHOTON_STREAM_DOMAIN 0x50484F54ull
+
+Sampler::Sampler(u_int64_t seed, SampleSequence sequence) :
+    m_seed(MixBits(seed)), m_sequence(sequence), m_streamKey(0), m_sampleIndex(0), m_dimension(0) {}
+
+void Sampler::StartPixelSample(u_int32_t x, u_int32_t y, u_int32_t sampleIndex)
+{
+    u_int64_t pixelKey = MixBits(m_seed ^ PIXEL_STREAM_DOMAIN) ^ (((u_int64_t)y << 32) | x);
+    m_streamKey = MixBits(pixelKey);
+    m_sampleIndex = sampleIndex;
+    m_dimension = 0;
+}
+
+void Sampler::StartPhoton(u_int64_t photonIndex)
+{
+    m_streamKey = MixBits((m_seed ^ PHOTON_STREAM_DOMAIN) + ((photonIndex >> 32) * 0x9E3779B97F4A7C15ull));
+    m_sampleIndex = photonIndex;
+    m_dimension = 0;
+}
+
+float Sampler::Get1D()
+{
+    if (m_sequence == SampleSequence::ScrambledSobol)
+        return Get2D().x;
+
+    u_int64_t bits = MixBits(MixBits(m_streamKey ^ m_sampleIndex) + (u_int64_t)m_dimension * 0x9E3779B97F4A7C15ull);
+    m_dimension++;
+
+    // Top 24 Bits give every Float in [0, 1) with Equal Spacing
+    return (bits >> 40) * (1.0f / 16777216.0f);
+}
+
+glm::vec2 Sampler::Get2D()
+{
+    if (m_sequence == SampleSequence::ScrambledSobol)
+    {
+        // Every Pair of Dimensions is Scrambled Independently, so Pairs stay Decorrelated from each other
+        u_int32_t dimensionSeed = MixBits(m_streamKey + (u_int64_t)m_dimension * 0x9E3779B97F4A7C15ull);
+        m_dimension++;
+
+        return ScrambledSobol2D((u_int32_t)m_sampleIndex, dimensionSeed);
+    }
+
+    float u = Get1D();
+    float v = Get1D();
+    return glm::vec2(u, v);
+}
+
+glm::vec3 Sampler::GetUnitSphere()
+{
+    // Equal-Area Mapping, so Stratified 2D Points give Stratified Directions
+    glm::vec2 u = Get2D();
+
+    float z = 1.0f - (2.0f * u.x);
+    float r = glm::sqrt(glm::max(0.0f, 1.0f - (z * z)));
+    float phi = glm::two_pi<float>() * u.y;
+
+    return glm::vec3(r * glm::cos(phi), r * glm::sin(phi), z);
+}
+
+u_int64_t Sampler::MixBits(u_int64_t value)
+{
+    // SplitMix64 Finaliser
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+u_int32_t Sampler::ReverseBits(u_int32_t value)
+{
+    value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+    value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+    value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+    value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+    return (value >> 16) | (value << 16);
+}
+
+u_int32_t Sampler::NestedUniformScramble(u_int32_t value, u_int32_t seed)
+{
+    // Hash-Based Owen Scrambling (Burley 2020), a Laine-Karras Permutation on the Reversed Bits
+    value = ReverseBits(value);
+    value += seed;
+    value ^= value * 0x6C50B47Cu;
+    value ^= value * 0xB82F1E52u;
+    value ^= value * 0xC7AFE638u;
+    value ^= value * 0x8D22F6E6u;
+    return ReverseBits(value);
+}
+
+glm::vec2 Sampler::ScrambledSobol2D(u_int32_t index, u_int32_t seed)
+{
+    // Shuffling the Index keeps every Power-of-Two Prefix of Samples Stratified
+    index = NestedUniformScramble(index, seed);
+
+    // First Two Sobol Dimensions: van der Corput, and the Pascal Matrix Generated from it
+    u_int32_t x = ReverseBits(index);
+    u_int32_t y = 0;
+    for (u_int32_t direction = 0x80000000u; index != 0; index >>= 1, direction ^= direction >> 1)
+    {
+        if (index & 1)
+            y ^= direction;
+    }
+
+    x = NestedUniformScramble(x, (u_int32_t)MixBits(seed ^ 0xA511E9B3ull));
+    y = NestedUniformScramble(y, (u_int32_t)MixBits(seed ^ 0x63D83595ull));
+
+    // Top 24 Bits, as Float cannot Represent the Full 32 Bits below 1.0
+    return glm::vec2((x >> 8) * (1.0f / 16777216.0f), (y >> 8) * (1.0f / 16777216.0f));
+}
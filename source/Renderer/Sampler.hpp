@@ -0,0 +1,44 @@
+#pragma once
+
+#include <sys/types.h>
+#include <glm/glm.hpp>
+
+enum class SampleSequence
+{
+    UniformRandom,  // Independent Hashed Values for every Dimension
+    ScrambledSobol  // Owen-Scrambled (0,2)-Sequence for every Pair of Dimensions
+};
+
+// Counter-Based Sample Streams
+// Every Value is a Hash of (Seed, Stream Key, Sample Index, Dimension), so no State is Shared between Threads
+// and a Render is Reproducible from its Seed regardless of how Work is Scheduled
+class Sampler
+{
+public:
+    Sampler(u_int64_t seed, SampleSequence sequence);
+
+private:
+    u_int64_t m_seed;
+    SampleSequence m_sequence;
+
+    u_int64_t m_streamKey;
+    u_int64_t m_sampleIndex;
+    u_int32_t m_dimension;
+
+public:
+    // Each Pixel and the Set of all Photons gets its own Stream, Indexed by Sample or Photon; Bounces then Consume Successive Dimensions
+    void StartPixelSample(u_int32_t x, u_int32_t y, u_int32_t sampleIndex);
+    // Sobol Points are Indexed by the Low 32 Bits, and each 2^32 Photons Scrambled by their own Stream, so Long Progressive Runs never Repeat a Photon
+    void StartPhoton(u_int64_t photonIndex);
+
+    float Get1D();
+    glm::vec2 Get2D();
+    glm::vec3 GetUnitSphere();
+
+private:
+    static u_int64_t MixBits(u_int64_t value);
+
+    static u_int32_t ReverseBits(u_int32_t value);
+    static u_int32_t NestedUniformScramble(u_int32_t value, u_int32_t seed);
+    static glm::vec2 ScrambledSobol2D(u_int32_t index, u_int32_t seed);
+};
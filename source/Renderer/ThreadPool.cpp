@@ -0,0 +1,119 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(u_int32_t threadCount) :
+    m_workers(std::vector<std::thread>()), m_taskQueues(std::vector<TaskQueue*>()),
+    m_remainingTasks(0), m_batchGeneration(0), m_shutdown(false)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (u_int32_t i = 0; i < threadCount; i++)
+        m_taskQueues.push_back(new TaskQueue());
+    for (u_int32_t i = 0; i < threadCount; i++)
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_batchLock);
+        m_shutdown = true;
+    }
+    m_batchStarted.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+    for (TaskQueue* queue : m_taskQueues)
+        delete queue;
+}
+
+void ThreadPool::ParallelFor(u_int32_t taskCount, std::function<void(u_int32_t taskID, u_int32_t threadID)> task)
+{
+    if (taskCount == 0)
+        return;
+
+    // Must be Visible before any Task can be Popped
+    m_batchTask = task;
+    m_remainingTasks = taskCount;
+
+    // Hand each Worker a Contiguous Block, so Neighbouring Tasks Start on the same Thread
+    u_int32_t queueCount = m_taskQueues.size();
+    for (u_int32_t q = 0; q < queueCount; q++)
+    {
+        u_int32_t begin = (u_int64_t)taskCount * q / queueCount;
+        u_int32_t end = (u_int64_t)taskCount * (q + 1) / queueCount;
+
+        std::lock_guard<std::mutex> guard(m_taskQueues[q]->lock);
+        for (u_int32_t t = begin; t < end; t++)
+            m_taskQueues[q]->taskIDs.push_back(t);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_batchLock);
+        m_batchGeneration++;
+    }
+    m_batchStarted.notify_all();
+
+    std::unique_lock<std::mutex> lock(m_batchLock);
+    m_batchFinished.wait(lock, [this]() { return m_remainingTasks == 0; });
+}
+
+void ThreadPool::WorkerLoop(u_int32_t threadID)
+{
+    u_int64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_batchLock);
+            m_batchStarted.wait(lock, [this, &seenGeneration]() { return m_shutdown || m_batchGeneration != seenGeneration; });
+            if (m_shutdown)
+                return;
+
+            seenGeneration = m_batchGeneration;
+        }
+
+        u_int32_t taskID;
+        while (PopTask(threadID, taskID))
+        {
+            m_batchTask(taskID, threadID);
+
+            if (m_remainingTasks.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> guard(m_batchLock);
+                m_batchFinished.notify_all();
+            }
+        }
+    }
+}
+
+bool ThreadPool::PopTask(u_int32_t threadID, u_int32_t& taskID)
+{
+    {
+        TaskQueue* ownQueue = m_taskQueues[threadID];
+        std::lock_guard<std::mutex> guard(ownQueue->lock);
+        if (!ownQueue->taskIDs.empty())
+        {
+            taskID = ownQueue->taskIDs.front();
+            ownQueue->taskIDs.pop_front();
+            return true;
+        }
+    }
+
+    // Own Queue is Empty, so Steal from the Far End of another Worker's Queue
+    u_int32_t queueCount = m_taskQueues.size();
+    for (u_int32_t i = 1; i < queueCount; i++)
+    {
+        TaskQueue* victimQueue = m_taskQueues[(threadID + i) % queueCount];
+        std::lock_guard<std::mutex> guard(victimQueue->lock);
+        if (!victimQueue->taskIDs.empty())
+        {
+            taskID = victimQueue->taskIDs.back();
+            victimQueue->taskIDs.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent Pool of Worker Threads, each with its own Task Queue
+// Idle Workers Steal Tasks from the Back of other Workers' Queues
+class ThreadPool
+{
+public:
+    ThreadPool(u_int32_t threadCount);
+    ~ThreadPool();
+
+private:
+    struct TaskQueue
+    {
+        std::mutex lock;
+        std::deque<u_int32_t> taskIDs;
+    };
+
+    std::vector<std::thread> m_workers;
+    std::vector<TaskQueue*> m_taskQueues;
+
+    std::function<void(u_int32_t, u_int32_t)> m_batchTask;
+    std::atomic<u_int32_t> m_remainingTasks;
+
+    std::mutex m_batchLock;
+    std::condition_variable m_batchStarted;
+    std::condition_variable m_batchFinished;
+    u_int64_t m_batchGeneration;
+    bool m_shutdown;
+
+public:
+    u_int32_t threadCount() { return m_workers.size(); }
+
+    // Runs task(taskID, threadID) for every taskID in [0, taskCount), Blocking until all have Finished
+    void ParallelFor(u_int32_t taskCount, std::function<void(u_int32_t taskID, u_int32_t threadID)> task);
+
+private:
+    void WorkerLoop(u_int32_t threadID);
+    bool PopTask(u_int32_t threadID, u_int32_t& taskID);
+};